@@ -24,21 +24,21 @@ void addFiles() {
                 formatColors("[error][inverse] ✘ [noinverse] You can't add items to text. [blank][help] ⬤ Try copying text first, or add "
                              "text instead.[blank]\n")
         );
-    for (const auto& f : copying.items)
-        copyItem(f);
+    for (auto& root : copying.plan.roots)
+        copyItem(root);
 }
 
 void addData() {
     if (path.holdsRawDataInCurrentEntry()) {
         std::string content;
         if (io_type == IOType::Pipe)
-            content = pipedInContent();
+            content = pipedInContent(true, tee_output);
         else
             for (size_t i = 0; i < copying.items.size(); i++) {
                 content += copying.items.at(i).string();
                 if (i != copying.items.size() - 1) content += " ";
             }
-        successes.bytes += writeToFile(path.data.raw, content, true);
+        successes.bytes += writeRawData(path.data.raw, content, true);
     } else if (!fs::is_empty(path.data)) {
         error_exit(
                 "%s",
@@ -50,8 +50,8 @@ void addData() {
             pipeIn();
         else if (io_type == IOType::Text)
             for (size_t i = 0; i < copying.items.size(); i++) {
-                successes.bytes += writeToFile(path.data.raw, copying.items.at(i).string());
-                if (i != copying.items.size() - 1) successes.bytes += writeToFile(path.data.raw, " ");
+                successes.bytes += writeRawData(path.data.raw, copying.items.at(i).string());
+                if (i != copying.items.size() - 1) successes.bytes += writeRawData(path.data.raw, " ");
             }
     }
 }
@@ -33,13 +33,29 @@ void clear() {
             unsigned long clipboards_cleared = 0;
             if (decision.substr(0, 1) != "y" && decision.substr(0, 1) != "Y") return;
             startIndicator();
-            for (const auto& entry : fs::directory_iterator(global_path.temporary)) {
-                fs::remove_all(entry);
-                clipboards_cleared++;
+            // each clipboard disappears in one rename before it's removed, so nobody reading it without the lock finds it half gone
+            auto removeWhole = [](const fs::path& clipboard) {
+                auto aside = clipboard.parent_path() / ("." + clipboard.filename().string() + "." + std::to_string(thisPID()) + std::string(constants.staging_extension));
+                std::error_code ec;
+                renamePath(clipboard, aside, ec);
+                removeRecursively(ec ? clipboard : aside);
+            };
+            try {
+                for (const auto& directory : {global_path.temporary, global_path.persistent})
+                    for (const auto& clipboard : fs::directory_iterator(directory))
+                        if (fs::exists(clipboard.path() / constants.metadata_directory / constants.moved_files_name))
+                            Clipboard(clipboard.path().filename().string()).returnMovedItems();
+            } catch (const fs::filesystem_error& e) {
+                error_exit(formatColors("[error][inverse] ✘ [noinverse] CB couldn't clear all clipboards because %s. [help]⬤ Try pasting what you cut first.[blank]\n"), e.code().message());
             }
-            for (const auto& entry : fs::directory_iterator(global_path.persistent)) {
-                fs::remove_all(entry);
-                clipboards_cleared++;
+            for (const auto& directory : {global_path.temporary, global_path.persistent}) {
+                std::vector<fs::path> clipboards;
+                for (const auto& entry : fs::directory_iterator(directory))
+                    clipboards.emplace_back(entry.path());
+                for (const auto& clipboard : clipboards) {
+                    removeWhole(clipboard);
+                    if (!isCatalogFile(clipboard)) clipboards_cleared++;
+                }
             }
             stopIndicator();
             fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Cleared %d clipboard%s[blank]\n").data(), clipboards_cleared, clipboards_cleared == 1 ? "" : "s");
@@ -79,16 +95,30 @@ void clear() {
                 return;
             }
 
-            // Now clear these entries
+            // what a cut moved into these entries goes back first, since clearing would otherwise remove the only copy of it
+            try {
+                for (const auto& entry : entries_to_clear)
+                    path.returnMovedItems(path.entryNumberAt(entry));
+            } catch (const fs::filesystem_error& e) {
+                error_exit(formatColors("[error][inverse] ✘ [noinverse] CB couldn't clear these entries because %s. [help]⬤ Try pasting what you cut into them first.[blank]\n"), e.code().message());
+            }
+
+            // Now clear these entries, each in a staged copy that then replaces it whole
+            auto current = path.entry();
             for (const auto& entry : entries_to_clear) {
-                for (const auto& item : fs::directory_iterator(path.entryPathFor(entry)))
-                    fs::remove_all(item);
+                path.setEntry(entry);
+                path.stageEntryChange();
+                for (const auto& item : fs::directory_iterator(path.data))
+                    removeRecursively(item);
+                path.publishEntry();
             }
+            path.setEntry(current);
 
         } else {
-            fs::remove(path.metadata.originals);
-            fs::remove(path.metadata.notes);
-            fs::remove(path.metadata.ignore);
+            fs::remove(path.metadata.originals); // moved items stay listed, since their entries are still in the history and clearing those puts them back
+            path.manifest().notes.reset();
+            path.manifest().ignore.reset();
+            path.saveManifest();
         }
         stopIndicator();
         if (!output_silent && !confirmation_silent) fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Cleared clipboard[blank]\n").data());
@@ -34,6 +34,9 @@ void config() {
     // Max history size
     fprintf(stderr, formatColors("[info]%s┃ Max history size: [help]%s[blank]\n").data(), generatedEndbar().data(), !maximumHistorySize.empty() ? maximumHistorySize.data() : "unlimited");
 
+    // Hot tier
+    fprintf(stderr, formatColors("[info]%s┃ Hot tier size: [help]%s[blank]\n").data(), generatedEndbar().data(), getenv("CLIPBOARD_HOT_TIER") ? getenv("CLIPBOARD_HOT_TIER") : "unlimited");
+
     // Locale
     fprintf(stderr, formatColors("[info]%s┃ Locale: [help]%s[blank]\n").data(), generatedEndbar().data(), !locale.empty() ? locale.data() : "default");
 
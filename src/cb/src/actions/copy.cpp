@@ -17,32 +17,52 @@
 
 namespace PerformAction {
 
-void copyItem(const fs::path& f, const bool use_regular_copy) {
-    auto actuallyCopyItem = [&] {
-        if (fs::is_directory(f)) {
-            auto target = f.filename().empty() ? f.parent_path().filename() : f.filename();
-            fs::create_directories(path.data / target);
-            fs::copy(f, path.data / target, copying.opts);
-        } else {
-            fs::copy(f, path.data / f.filename(), use_regular_copy ? copying.opts : copying.opts | fs::copy_options::create_hard_links);
-        }
-        incrementSuccessesForItem(f);
-        if (action == Action::Cut) writeToFile(path.metadata.originals, fs::absolute(f).string() + "\n", true);
-    };
+bool moveItem(const CopyPlan::Root& root) {
+    auto source = root.item.filename().empty() ? root.item.parent_path() : root.item;
+    std::error_code ec;
+    auto isDirectory = fs::is_directory(fs::symlink_status(source, ec));
+    renamePath(source, path.data / source.filename(), ec);
+    if (ec) return false; // another mount of the same filesystem, or anything else a copy might still get past
+    isDirectory ? successes.directories++ : successes.files++;
+    writeToFile(path.metadata.moved, std::to_string(path.entryIndex.at(path.entry())) + " " + fs::absolute(source).string() + "\n", true);
+    return true;
+}
+
+void copyItem(CopyPlan::Root& root, const bool use_regular_copy) {
+    if (root.ignored) return;
+    if (root.movable && (moveItem(root) || !copying.plan.expand(root))) return;
+    // hard links among the items stay hard links in the clipboard instead of becoming separate copies
+    std::map<std::pair<uint64_t, uint64_t>, fs::path> linkedTargets;
     try {
-        actuallyCopyItem();
-    } catch (const fs::filesystem_error& e) {
-        if (!use_regular_copy && e.code() == std::errc::cross_device_link) {
-            copyItem(f, true);
-        } else {
-            copying.failedItems.emplace_back(f.string(), e.code());
+        for (auto i = root.first; i < root.last; i++) {
+            const auto& item = copying.plan.items.at(i);
+            auto target = path.data / item.target;
+            if (item.type == fs::file_type::directory) {
+                fs::create_directory(target, item.source); // its parent always comes first, and like fs::copy this keeps its permissions
+            } else if (item.type == fs::file_type::symlink) {
+                std::error_code ec;
+                fs::remove(target, ec);
+                fs::copy_symlink(item.source, target);
+            } else if (auto linked = item.linked ? linkedTargets.find({item.device, item.inode}) : linkedTargets.end(); linked != linkedTargets.end()) {
+                std::error_code ec;
+                fs::remove(target, ec);
+                fs::create_hard_link(linked->second, target);
+                copying.plan.copied += item.size;
+            } else {
+                cowCopyFile(item.source, target, use_regular_copy, [](const unsigned long long& bytes) { copying.plan.copied += bytes; });
+                if (item.linked) linkedTargets.emplace(std::make_pair(item.device, item.inode), target);
+            }
         }
+        copying.plan.items.at(root.first).type == fs::file_type::directory ? successes.directories++ : successes.files++;
+        if (action == Action::Cut) writeToFile(path.metadata.originals, fs::absolute(root.item).string() + "\n", true);
+    } catch (const fs::filesystem_error& e) {
+        copying.failedItems.emplace_back(root.item.string(), e.code());
     }
 }
 
 void copy() {
-    for (const auto& f : copying.items)
-        copyItem(f);
+    for (auto& root : copying.plan.roots)
+        copyItem(root);
 }
 
 void copyText() {
@@ -50,7 +70,7 @@ void copyText() {
         copying.buffer += copying.items.at(i).string();
         if (i != copying.items.size() - 1) copying.buffer += " ";
     }
-    writeToFile(path.data.raw, copying.buffer);
+    writeRawData(path.data.raw, copying.buffer);
 
     if (!output_silent && !confirmation_silent) {
         stopIndicator();
@@ -26,6 +26,14 @@ void edit() {
             std::ofstream temp(path.data.raw);
     }
 
+    // editors need a plain file, so unpack a compressed entry first and pack it again once the editor is done
+    bool wasCompressed = storedRawData(path.data.raw).second != Codec::None;
+    if (wasCompressed) {
+        auto content = rawDataContents(path.data.raw).value();
+        fs::remove(storedRawData(path.data.raw).first);
+        writeToFile(path.data.raw, content);
+    }
+
     auto editor = findUsableEditor();
 
     if (!editor) error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't find a suitable editor to use. [help]⬤ Try setting the CLIPBOARD_EDITOR environment variable.[blank]\n"));
@@ -38,6 +46,8 @@ void edit() {
     int res = system(command.data());
 
     if (res != 0) error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't open the editor. [help]⬤ Try setting the CLIPBOARD_EDITOR environment variable.[blank]\n"));
+
+    if (wasCompressed || configuredCodec() != Codec::None) writeRawData(path.data.raw, fileContents(path.data.raw).value_or(""));
 }
 
 } // namespace PerformAction
\ No newline at end of file
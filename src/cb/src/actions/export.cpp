@@ -15,23 +15,171 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
 
+#if defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
 namespace PerformAction {
 
+class PackWriter {
+    std::FILE* file;
+
+public:
+    PackWriter(std::FILE* file) : file(file) {}
+
+    void bytes(const std::string_view& data) {
+        if (fwrite(data.data(), 1, data.size(), file) != data.size()) throw fs::filesystem_error("Couldn't write to the pack", std::error_code(errno, std::generic_category()));
+    }
+
+    void integer(const auto& value) {
+        std::array<char, sizeof(value)> buffer;
+        for (size_t i = 0; i < sizeof(value); i++)
+            buffer[i] = static_cast<char>((static_cast<unsigned long long>(value) >> (i * 8)) & 0xFF);
+        bytes({buffer.data(), buffer.size()});
+    }
+
+    void record(const PackRecord& kind, const Codec& codec, const uint32_t& mode, const int64_t& modified, const uint64_t& size, const std::string& name) {
+        integer(static_cast<uint8_t>(kind));
+        integer(static_cast<uint8_t>(codec));
+        integer(static_cast<uint16_t>(0));
+        integer(mode);
+        integer(modified);
+        integer(size);
+        integer(static_cast<uint32_t>(name.size()));
+        bytes(name);
+    }
+
+    void block(const std::string_view& data, const Codec& codec) {
+        auto compressed = codec == Codec::None ? std::nullopt : compressBlock(data, codec);
+        integer(static_cast<uint32_t>(data.size()));
+        integer(static_cast<uint32_t>(compressed ? compressed->size() : data.size()));
+        bytes(compressed ? std::string_view(compressed.value()) : data);
+    }
+
+    void endBlocks() { integer(static_cast<uint64_t>(0)); }
+};
+
+void exportPack(const std::vector<std::string>& names) {
+    std::FILE* output = stdout;
+    if (pack_file != "-") output = fopen(pack_file.data(), "wb");
+    if (output == nullptr)
+        error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't create the pack file. [help]⬤ Try checking if you have the right permissions or not.[blank]\n"));
+#if defined(_WIN32) || defined(_WIN64)
+    if (output == stdout) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    PackWriter pack(output);
+    pack.bytes(constants.pack_signature);
+
+    auto secondsSinceEpoch = [](const fs::path& item) -> int64_t {
+        auto modified = fs::file_time_type::clock::to_sys(fs::last_write_time(item));
+        return std::chrono::duration_cast<std::chrono::seconds>(modified.time_since_epoch()).count();
+    };
+
+
+    auto exportClipboard = [&](const std::string& name) {
+        try {
+            Clipboard clipboard(name);
+            clipboard.getLock();
+            if (clipboard.isUnused()) {
+                clipboard.releaseLock();
+                return;
+            }
+
+            std::vector<std::pair<fs::directory_entry, std::string>> items;
+            for (const auto& entry : fs::recursive_directory_iterator(fs::path(clipboard)))
+                if (entry.path() != clipboard.metadata.lock) items.emplace_back(entry, entry.path().lexically_relative(clipboard).generic_string());
+            // entries that were moved out of RAM travel along under their own directory so importing puts them back in the cold tier
+            if (auto cold = clipboard.coldTier(); !cold.empty() && fs::is_directory(cold)) {
+                items.emplace_back(fs::directory_entry(cold), std::string(constants.cold_tier_directory));
+                for (const auto& entry : fs::recursive_directory_iterator(cold))
+                    items.emplace_back(entry, (fs::path(constants.cold_tier_directory) / entry.path().lexically_relative(cold)).generic_string());
+            }
+
+            // The manifest lets a reader see everything in this clipboard before any payloads arrive
+            std::string manifest;
+            for (const auto& [item, relative] : items)
+                manifest += (item.is_symlink() ? "l " : item.is_directory() ? "d " : "f ") + std::to_string(item.is_regular_file() ? item.file_size() : 0) + " " + relative + "\n";
+
+            pack.record(PackRecord::Clipboard, Codec::None, 0, secondsSinceEpoch(clipboard), manifest.size(), name);
+            for (size_t i = 0; i < manifest.size(); i += pack_block_size)
+                pack.block(std::string_view(manifest).substr(i, pack_block_size), preferredCodec());
+            pack.endBlocks();
+
+            for (const auto& [item, relative] : items) {
+                auto mode = static_cast<uint32_t>(item.symlink_status().permissions());
+                if (item.is_symlink()) {
+                    auto target = fs::read_symlink(item).string();
+                    pack.record(PackRecord::Symlink, Codec::None, mode, 0, target.size(), relative);
+                    pack.block(target, Codec::None);
+                    pack.endBlocks();
+                } else if (item.is_directory()) {
+                    pack.record(PackRecord::Directory, Codec::None, mode, secondsSinceEpoch(item), 0, relative);
+                    pack.endBlocks();
+                } else {
+                    // the first block decides the codec, since that's where formats that are already compressed say so
+                    std::optional<Codec> codec;
+                    auto writeBlock = [&](const std::string_view& chunk) {
+                        if (!codec) {
+                            codec = isAlreadyCompressed(chunk) ? Codec::None : preferredCodec();
+                            pack.record(PackRecord::File, codec.value(), mode, secondsSinceEpoch(item), item.file_size(), relative);
+                        }
+                        if (chunk.empty()) return true;
+                        pack.block(chunk, codec.value());
+                        successes.bytes += chunk.size();
+                        return true;
+                    };
+                    if (!streamFile(item.path(), writeBlock)) throw fs::filesystem_error("Couldn't open file", item.path(), std::error_code(errno, std::generic_category()));
+                    if (!codec) writeBlock({});
+                    pack.endBlocks();
+                }
+            }
+
+            clipboard.releaseLock();
+            successes.clipboards++;
+        } catch (const fs::filesystem_error& e) {
+            copying.failedItems.emplace_back(name, e.code());
+        }
+    };
+
+    for (const auto& name : names)
+        exportClipboard(name);
+
+    pack.record(PackRecord::End, Codec::None, 0, 0, 0, "");
+    if (output == stdout)
+        fflush(stdout);
+    else
+        fclose(output);
+    successes.bytes = 0; // show the clipboard count rather than the byte count
+}
+
 void exportClipboards() {
     std::vector<std::string> destinations;
     if (!copying.items.empty())
         std::transform(copying.items.begin(), copying.items.end(), std::back_inserter(destinations), [](const auto& item) { return item.string(); });
     else {
         for (const auto& entry : fs::directory_iterator(global_path.temporary))
-            destinations.emplace_back(entry.path().filename().string());
+            if (!isCatalogFile(entry.path())) destinations.emplace_back(entry.path().filename().string());
         for (const auto& entry : fs::directory_iterator(global_path.persistent))
-            destinations.emplace_back(entry.path().filename().string());
+            if (!isCatalogFile(entry.path())) destinations.emplace_back(entry.path().filename().string());
+        deduplicate(destinations);
+    }
+
+    if (!pack_file.empty()) {
+        exportPack(destinations);
+        if (destinations.empty() || successes.clipboards == 0) {
+            stopIndicator();
+            fprintf(stderr, "%s", no_clipboard_contents_message().data());
+            error_exit(clipboard_action_prompt(), clipboard_invocation, clipboard_invocation);
+        }
+        return;
     }
 
     fs::path exportDirectory(fs::current_path() / "Exported_Clipboards");
 
     try {
-        if (fs::exists(exportDirectory)) fs::remove_all(exportDirectory);
+        if (fs::exists(exportDirectory)) removeRecursively(exportDirectory);
         fs::create_directory(exportDirectory);
     } catch (const fs::filesystem_error& e) {
         error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't create the export directory. [help]⬤ Try checking if you have the right permissions or not.[blank]\n"));
@@ -42,7 +190,8 @@ void exportClipboards() {
             Clipboard clipboard(name);
             clipboard.getLock();
             if (clipboard.isUnused()) return;
-            fs::copy(clipboard, exportDirectory / name, copying.opts);
+            cowCopy(clipboard, exportDirectory / name);
+            if (auto cold = clipboard.coldTier(); !cold.empty() && fs::is_directory(cold)) cowCopy(cold, exportDirectory / name / constants.cold_tier_directory);
             fs::remove(exportDirectory / name / constants.metadata_directory / constants.lock_name);
             clipboard.releaseLock();
             successes.clipboards++;
@@ -48,6 +48,7 @@ void moveHistory() {
     for (const auto& entry : copying.items) {
         try {
             unsigned long entryNum = std::stoul(entry.string());
+            path.materializeEntry(entryNum);
             absoluteEntryPaths.emplace_back(path.entryPathFor(entryNum));
         } catch (fs::filesystem_error& e) {
             copying.failedItems.emplace_back(entry.string(), e.code());
@@ -56,9 +57,10 @@ void moveHistory() {
     }
     for (const auto& entry : absoluteEntryPaths) {
         path.makeNewEntry();
-        fs::rename(entry, path.data);
+        renamePath(entry, path.data);
         successful_entries++;
     }
+    path.publishEntry();
     stopIndicator();
     fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Queued up [bold]%lu[blank][success] entries[blank]\n").data(), successful_entries);
     if (clipboard_name == constants.default_clipboard_name) updateExternalClipboards(true);
@@ -69,31 +71,24 @@ void history() {
         moveHistory();
         return;
     }
-    std::vector<std::string> dates(path.entryIndex.size());
-    std::vector<std::string> sizes(path.entryIndex.size());
+    std::vector<std::string> dates;
+    std::vector<std::string> sizes;
 
     std::atomic<size_t> atomicLongestDateLength = 0;
     std::atomic<size_t> atomicLongestSizeLength = 0;
 
     auto now = std::chrono::system_clock::now();
 
-    auto totalThreads = suitableThreadAmount();
-    if (path.entryIndex.size() < totalThreads) totalThreads = path.entryIndex.size();
-
-    auto entriesPerThread = path.entryIndex.size() / totalThreads;
-
-    std::vector<std::thread> threads(totalThreads);
-
     auto dataWorker = [&](const unsigned long& start, const unsigned long& end) {
-        struct stat dateInfo;
         std::string agoMessage;
         agoMessage.reserve(16);
 
         for (auto entry = start; entry < end; entry++) {
             auto thisEntrysPath = path.entryPathFor(entry);
+            auto segment = path.segmentedEntry(entry);
 #if defined(UNIX_OR_UNIX_LIKE)
-            stat(thisEntrysPath.string().data(), &dateInfo);
-            auto timeSince = now - std::chrono::system_clock::from_time_t(dateInfo.st_mtime);
+            auto writeTime = segment ? segment->writeTime() : cachedStatus(thisEntrysPath).write_time;
+            auto timeSince = now - std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(writeTime));
             // format time like 1y 2d 3h 4m 5s
             auto years = std::chrono::duration_cast<std::chrono::years>(timeSince);
             auto days = std::chrono::duration_cast<std::chrono::days>(timeSince - years);
@@ -115,8 +110,10 @@ void history() {
 #endif
 
             size_t size = 0;
-            if (auto temp(fileContents(thisEntrysPath / constants.data_file_name)); temp.has_value())
-                size = temp.value().length();
+            if (segment)
+                size = segment->length;
+            else if (auto temp(rawDataSize(thisEntrysPath / constants.data_file_name)); temp.has_value())
+                size = temp.value();
             else
                 size = totalDirectorySize(thisEntrysPath);
             sizes[entry] = formatBytes(size);
@@ -124,11 +121,28 @@ void history() {
         }
     };
 
-    for (unsigned long thread = 0; thread < totalThreads; thread++) {
-        auto start = thread * entriesPerThread;
-        auto end = start + entriesPerThread;
-        if (thread == totalThreads - 1) end = path.entryIndex.size();
-        threads[thread] = std::thread(dataWorker, start, end);
+    // older shards are only listed once the walk reaches them, so each one gets its own round of workers
+    for (unsigned long first = 0; first < path.entryIndex.size() || path.listNextShard(); first = path.entryIndex.size()) {
+        auto last = path.entryIndex.size();
+        dates.resize(last);
+        sizes.resize(last);
+
+        auto totalThreads = suitableThreadAmount();
+        if (last - first < totalThreads) totalThreads = last - first;
+
+        auto entriesPerThread = (last - first) / totalThreads;
+
+        std::vector<std::thread> threads(totalThreads);
+
+        for (unsigned long thread = 0; thread < totalThreads; thread++) {
+            auto start = first + thread * entriesPerThread;
+            auto end = start + entriesPerThread;
+            if (thread == totalThreads - 1) end = last;
+            threads[thread] = std::thread(dataWorker, start, end);
+        }
+
+        for (auto& thread : threads)
+            thread.join();
     }
 
     // for (auto& thread : threads)
@@ -176,9 +190,6 @@ void history() {
             formatColors("[nobold]│ [bold]"),
             formatColors("[nobold]│[help] ")};
 
-    for (auto& thread : threads)
-        thread.join();
-
     size_t longestDateLength = atomicLongestDateLength.load(std::memory_order_relaxed);
     size_t longestSizeLength = atomicLongestSizeLength.load(std::memory_order_relaxed);
 
@@ -215,7 +226,7 @@ void history() {
                           + std::string(longestDateLength - dates.at(entry).length(), ' ') + dates.at(entry) + preformattedMessageParts[1]
                           + std::string(longestSizeLength - sizes.at(entry).length(), ' ') + sizes.at(entry) + preformattedMessageParts[2];
 
-        if (auto temp(fileContents(path.data.raw)); temp.has_value()) {
+        if (auto temp(rawDataContents(path.data.raw, raw_preview_size)); temp.has_value()) {
             auto content = std::move(temp.value());
             if (content.empty()) continue; // don't use holdsRawDataInCurrentEntry because we are reading anyway, so we can save on a syscall
             if (auto MIMEtype = inferMIMEType(content); MIMEtype.has_value())
@@ -229,7 +240,7 @@ void history() {
 
         for (bool first = true; const auto& entry : fs::directory_iterator(path.data)) {
             auto filename = entry.path().filename().string();
-            if (filename == constants.data_file_name && entry.file_size() == 0) continue;
+            if (isRawDataFile(filename) && entry.file_size() == 0) continue;
 
             if (widthRemaining <= 0) break;
 
@@ -288,21 +299,21 @@ void history() {
 
 void historyJSON() {
     printf("{\n");
-    for (unsigned long entry = 0; entry < path.entryIndex.size(); entry++) {
+    for (unsigned long entry = 0; entry < path.entryIndex.size() || path.listNextShard(); entry++) {
         path.setEntry(entry);
-        printf("    \"%lu\": {\n", entry);
-        printf("        \"date\": %zu,\n", static_cast<size_t>(fs::last_write_time(path.data).time_since_epoch().count()));
+        printf("%s    \"%lu\": {\n", entry == 0 ? "" : ",\n", entry);
+        printf("        \"date\": %zu,\n", static_cast<size_t>(path.entryWriteTime(entry).time_since_epoch().count()));
         printf("        \"content\": ");
         if (path.holdsRawDataInCurrentEntry()) {
-            std::string content(fileContents(path.data.raw).value());
+            std::string content(rawDataContents(path.data.raw, raw_preview_size).value());
             if (auto type = inferMIMEType(content); type.has_value()) {
                 printf("{\n");
                 printf("            \"dataType\": \"%s\",\n", type.value().data());
-                printf("            \"dataSize\": %zd,\n", content.length());
-                printf("            \"path\": \"%s\"\n", JSONescape(path.data.raw.string()).data());
+                printf("            \"dataSize\": %zd,\n", rawDataSize(path.data.raw).value());
+                printf("            \"path\": \"%s\"\n", JSONescape(storedRawData(path.data.raw).first.string()).data());
                 printf("        }");
             } else {
-                printf("\"%s\"", JSONescape(content).data());
+                printf("\"%s\"", JSONescape(rawDataContents(path.data.raw).value()).data());
             }
         } else if (path.holdsDataInCurrentEntry()) {
             printf("[\n");
@@ -318,9 +329,9 @@ void historyJSON() {
         } else {
             printf("null");
         }
-        printf("\n    }%s\n", entry == path.entryIndex.size() - 1 ? "" : ",");
+        printf("\n    }");
     }
-    printf("}\n");
+    printf("\n}\n");
 }
 
 } // namespace PerformAction
@@ -26,8 +26,8 @@ void ignoreRegex() {
         std::transform(copying.items.begin(), copying.items.end(), std::back_inserter(regexes), [](const auto& item) { return item.string(); });
 
     if (regexes.empty()) {
-        if (fs::exists(path.metadata.ignore) && !fs::is_empty(path.metadata.ignore)) {
-            std::vector<std::string> ignorePatterns(fileLines(path.metadata.ignore));
+        if (path.holdsIgnoreRegexes()) {
+            std::vector<std::string> ignorePatterns(contentLines(path.manifest().ignore.value()));
 
             if (is_tty.out) {
                 stopIndicator();
@@ -47,7 +47,8 @@ void ignoreRegex() {
     }
 
     if (regexes.size() == 1 && (regexes.at(0) == "" || regexes.at(0) == "\n")) {
-        fs::remove(path.metadata.ignore);
+        path.manifest().ignore.reset();
+        path.saveManifest();
         if (output_silent || confirmation_silent) return;
         stopIndicator();
         fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Removed ignore patterns\n").data());
@@ -72,7 +73,8 @@ void ignoreRegex() {
     for (const auto& pattern : regexes)
         writeToFileContent += pattern + "\n";
 
-    writeToFile(path.metadata.ignore, writeToFileContent);
+    path.manifest().ignore = writeToFileContent;
+    path.saveManifest();
 
     stopIndicator();
     fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Saved ignore patterns [bold]").data());
@@ -81,6 +83,7 @@ void ignoreRegex() {
         if (pattern != regexes.back()) fprintf(stderr, ", ");
     }
     fprintf(stderr, "%s", formatColors("[blank]\n").data());
+    path.forgetIgnoreRules();
     path.applyIgnoreRules();
     exit(EXIT_SUCCESS);
 }
@@ -93,8 +96,8 @@ void ignoreSecret() {
         std::transform(copying.items.begin(), copying.items.end(), std::back_inserter(secrets), [](const auto& item) { return item.string(); });
 
     if (secrets.empty()) {
-        if (fs::exists(path.metadata.ignore_secret) && !fs::is_empty(path.metadata.ignore_secret)) {
-            std::vector<std::string> ignoreSecrets(fileLines(path.metadata.ignore_secret));
+        if (path.holdsIgnoreSecrets()) {
+            std::vector<std::string> ignoreSecrets(contentLines(path.manifest().ignore_secret.value()));
 
             if (is_tty.out) {
                 stopIndicator();
@@ -123,7 +126,8 @@ void ignoreSecret() {
             if (decision.substr(0, 1) != "y" && decision.substr(0, 1) != "Y") return;
             startIndicator();
         }
-        fs::remove(path.metadata.ignore_secret);
+        path.manifest().ignore_secret.reset();
+        path.saveManifest();
         if (output_silent || confirmation_silent) return;
         stopIndicator();
         fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Removed secrets to ignore[blank]\n").data());
@@ -140,7 +144,8 @@ void ignoreSecret() {
         writeToFileContent += ss.str() + "\n";
     }
 
-    writeToFile(path.metadata.ignore_secret, writeToFileContent);
+    path.manifest().ignore_secret = writeToFileContent;
+    path.saveManifest();
 
     stopIndicator();
     fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Saved ignore secrets [bold]").data());
@@ -149,6 +154,7 @@ void ignoreSecret() {
         if (secret != secrets.back()) fprintf(stderr, ", ");
     }
     fprintf(stderr, "%s", formatColors("[blank]\n").data());
+    path.forgetIgnoreRules();
     path.applyIgnoreRules();
     exit(EXIT_SUCCESS);
 }
@@ -15,9 +15,268 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
 
+#if defined(_WIN32) || defined(_WIN64)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#if defined(UNIX_OR_UNIX_LIKE)
+#include <sys/mman.h>
+#endif
+
 namespace PerformAction {
 
+class PackReader {
+    std::FILE* file = nullptr;
+    std::string_view mapping;
+    size_t offset = 0;
+    std::string buffer;
+
+public:
+    PackReader(std::FILE* file) : file(file) {}
+    PackReader(const std::string_view& mapping) : mapping(mapping) {}
+
+    bool isMapped() const { return file == nullptr; }
+
+    // With a mapped pack, the returned view stays valid for as long as the mapping does; otherwise, only until the next read
+    std::string_view bytes(const size_t& size) {
+        if (isMapped()) {
+            if (mapping.size() - offset < size) throw std::runtime_error("The pack ends unexpectedly");
+            auto view = mapping.substr(offset, size);
+            offset += size;
+            return view;
+        }
+        buffer.resize(size);
+        if (fread(buffer.data(), 1, size, file) != size) throw std::runtime_error("The pack ends unexpectedly");
+        return buffer;
+    }
+
+    template <typename T>
+    T integer() {
+        auto data = bytes(sizeof(T));
+        unsigned long long value = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+            value |= static_cast<unsigned long long>(static_cast<unsigned char>(data[i])) << (i * 8);
+        return static_cast<T>(value);
+    }
+};
+
+struct PackBlock {
+    uint32_t size;
+    std::string_view data;
+};
+
+void restoreBlocks(std::FILE* output, const std::vector<PackBlock>& blocks, const Codec& codec) {
+    for (const auto& block : blocks) {
+        auto content = block.data.size() == block.size ? std::string(block.data) : decompressBlock(block.data, block.size, codec);
+        if (fwrite(content.data(), 1, content.size(), output) != content.size()) throw std::runtime_error("Couldn't write a file from the pack");
+        successes.bytes += content.size();
+    }
+}
+
+void importPack(PackReader& pack) {
+    if (pack.bytes(constants.pack_signature.size()) != constants.pack_signature)
+        error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] The file you're trying to import from isn't a CB pack. [help]⬤ Try choosing a different one instead.[blank]\n"));
+
+    struct RestoreJob {
+        fs::path target;
+        fs::path within;
+        Codec codec;
+        fs::perms mode;
+        int64_t modified;
+        std::vector<PackBlock> blocks;
+    };
+    std::vector<RestoreJob> files;
+    std::vector<RestoreJob> directories;
+
+    fs::path root;
+    fs::path coldRoot;
+    std::vector<fs::path> roots;
+    bool skipping = false;
+
+    auto setModified = [](const fs::path& item, const int64_t& modified) {
+        std::error_code ec;
+        fs::last_write_time(item, fs::file_time_type::clock::from_sys(std::chrono::system_clock::time_point(std::chrono::seconds(modified))), ec);
+    };
+
+    // a symlink from earlier in the pack mustn't lead anything after it out of the clipboard, which checking the names alone can't catch
+    auto checkConfined = [](const fs::path& target, const fs::path& within, const bool& followTarget) {
+        std::error_code ec;
+        auto resolved = fs::weakly_canonical(followTarget ? target : target.parent_path(), ec);
+        if (ec || resolved.lexically_relative(fs::weakly_canonical(within, ec)).string().starts_with(".."))
+            throw std::runtime_error("The pack contains an unsafe path: " + target.string());
+    };
+
+    auto restoreFile = [&](const RestoreJob& job) {
+        checkConfined(job.target, job.within, true); // the symlink could have come after this file in the pack
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> output(fopen(job.target.string().data(), "wb"), &std::fclose);
+        if (!output) throw fs::filesystem_error("Couldn't create file", job.target, std::error_code(errno, std::generic_category()));
+        restoreBlocks(output.get(), job.blocks, job.codec);
+        output.reset();
+        fs::permissions(job.target, job.mode);
+        setModified(job.target, job.modified);
+        recordWrittenFile(job.target);
+    };
+
+    while (true) {
+        auto kind = static_cast<PackRecord>(pack.integer<uint8_t>());
+        if (kind == PackRecord::End) break;
+        RestoreJob job;
+        job.codec = static_cast<Codec>(pack.integer<uint8_t>());
+        pack.integer<uint16_t>();
+        job.mode = static_cast<fs::perms>(pack.integer<uint32_t>()) & fs::perms::mask;
+        job.modified = pack.integer<int64_t>();
+        pack.integer<uint64_t>();
+        fs::path name(std::string(pack.bytes(pack.integer<uint32_t>())));
+
+        if (name.is_absolute() || std::any_of(name.begin(), name.end(), [](const auto& part) { return part == ".."; }))
+            throw std::runtime_error("The pack contains an unsafe path: " + name.string());
+
+        if (kind == PackRecord::Clipboard) {
+            root = (isPersistent(name.string()) ? global_path.persistent : global_path.temporary) / name;
+            coldRoot = coldTierFor(name.string());
+            skipping = false;
+            auto alreadyHoldsData = [&] {
+                std::error_code ec;
+                for (const auto& entry : fs::directory_iterator(root / constants.data_directory, ec))
+                    if (!fs::is_empty(entry.path(), ec)) return true;
+                return false;
+            };
+            if (alreadyHoldsData()) {
+                using enum CopyPolicy;
+                if (copying.policy != SkipAll && copying.policy != ReplaceAll) {
+                    stopIndicator();
+                    copying.policy = userDecision(name.string());
+                    startIndicator();
+                }
+                skipping = copying.policy == SkipOnce || copying.policy == SkipAll;
+            }
+            if (!skipping) {
+                createDirectories(root);
+                roots.emplace_back(root);
+                successes.clipboards++;
+            }
+        } else if (root.empty())
+            throw std::runtime_error("The pack has items that don't belong to any clipboard");
+        job.target = root / name;
+        job.within = root;
+        if (!coldRoot.empty() && *name.begin() == constants.cold_tier_directory) {
+            job.target = coldRoot / name.lexically_relative(constants.cold_tier_directory);
+            job.within = coldRoot;
+        }
+        // only a symlink itself may point elsewhere, since nothing gets written through it
+        if (!skipping && kind != PackRecord::Clipboard) checkConfined(job.target, job.within, kind != PackRecord::Symlink);
+
+        bool writeNow = !skipping && kind == PackRecord::File && !pack.isMapped();
+        std::unique_ptr<std::FILE, decltype(&std::fclose)> output(nullptr, &std::fclose);
+        if (writeNow) {
+            output.reset(fopen(job.target.string().data(), "wb"));
+            if (!output) throw fs::filesystem_error("Couldn't create file", job.target, std::error_code(errno, std::generic_category()));
+        }
+        std::string symlinkTarget;
+        for (auto size = pack.integer<uint32_t>(), stored = pack.integer<uint32_t>(); size != 0; size = pack.integer<uint32_t>(), stored = pack.integer<uint32_t>()) {
+            PackBlock block {size, pack.bytes(stored)};
+            if (skipping) continue;
+            if (kind == PackRecord::Symlink)
+                symlinkTarget += block.data;
+            else if (writeNow)
+                restoreBlocks(output.get(), {block}, job.codec);
+            else if (kind == PackRecord::File)
+                job.blocks.emplace_back(block);
+        }
+        if (output) {
+            output.reset();
+            fs::permissions(job.target, job.mode);
+            setModified(job.target, job.modified);
+            recordWrittenFile(job.target);
+        }
+        if (skipping || kind == PackRecord::Clipboard) continue;
+
+        if (kind == PackRecord::Directory) {
+            createDirectories(job.target);
+            directories.emplace_back(std::move(job));
+        } else if (kind == PackRecord::Symlink) {
+            std::error_code ec;
+            fs::remove(job.target, ec);
+            fs::create_symlink(symlinkTarget, job.target);
+        } else if (kind == PackRecord::File && pack.isMapped())
+            files.emplace_back(std::move(job));
+    }
+
+    // Everything in a mapped pack can be read at once, so restore the files on several threads
+    std::atomic<size_t> nextFile = 0;
+    std::mutex failedItemsMutex;
+    auto restoreWorker = [&] {
+        for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+            try {
+                restoreFile(files.at(i));
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(failedItemsMutex);
+                copying.failedItems.emplace_back(files.at(i).target.string(), std::make_error_code(std::errc::io_error));
+            }
+        }
+    };
+    std::vector<std::thread> workers(std::max<size_t>(1, std::min<size_t>(suitableThreadAmount(), files.size())));
+    for (auto& worker : workers)
+        worker = std::thread(restoreWorker);
+    for (auto& worker : workers)
+        worker.join();
+
+    for (auto directory = directories.rbegin(); directory != directories.rend(); directory++) {
+        if (fs::is_symlink(directory->target)) continue; // a later symlink took its place, and permissions would go through it
+        fs::permissions(directory->target, directory->mode);
+        setModified(directory->target, directory->modified);
+    }
+    for (const auto& imported : roots)
+        discardCachedTotals(imported);
+    discardCatalog(); // an import can touch any number of clipboards, so the catalog gets rebuilt from scratch
+    successes.bytes = 0; // show the clipboard count rather than the byte count
+}
+
+void importPackFrom(const fs::path& file) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    if (file != "-") {
+        int fd = open(file.string().data(), O_RDONLY);
+        if (fd == -1) error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't open the pack you're trying to import from. [help]⬤ Try choosing a different one instead.[blank]\n"));
+        struct stat info;
+        fstat(fd, &info);
+        void* mapping = info.st_size > 0 ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+            PackReader pack(std::string_view(static_cast<const char*>(mapping), info.st_size));
+            importPack(pack);
+            munmap(mapping, info.st_size);
+            return;
+        }
+    }
+#endif
+    std::FILE* input = file == "-" ? stdin : fopen(file.string().data(), "rb");
+    if (input == nullptr) error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] CB couldn't open the pack you're trying to import from. [help]⬤ Try choosing a different one instead.[blank]\n"));
+#if defined(_WIN32) || defined(_WIN64)
+    if (input == stdin) _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    PackReader pack(input);
+    importPack(pack);
+    if (input != stdin) fclose(input);
+}
+
+bool isAPack(const fs::path& file) {
+    if (!fs::is_regular_file(file)) return false;
+    std::FILE* input = fopen(file.string().data(), "rb");
+    if (input == nullptr) return false;
+    std::string signature(constants.pack_signature.size(), '\0');
+    auto bytesRead = fread(signature.data(), 1, signature.size(), input);
+    fclose(input);
+    return bytesRead == signature.size() && signature == constants.pack_signature;
+}
+
 void importClipboards() {
+    if (io_type == IOType::Pipe || (!copying.items.empty() && (copying.items.at(0) == "-" || isAPack(copying.items.at(0))))) {
+        importPackFrom(io_type == IOType::Pipe ? fs::path("-") : copying.items.at(0));
+        return;
+    }
+
     fs::path importDirectory;
     if (copying.items.empty())
         importDirectory = fs::current_path() / "Exported_Clipboards";
@@ -43,6 +302,7 @@ void importClipboards() {
                         continue;
                     case ReplaceAll:
                         fs::copy(entry.path(), target, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+                        discardCachedTotals(target);
                         successes.clipboards++;
                         break;
                     default:
@@ -51,6 +311,7 @@ void importClipboards() {
                         startIndicator();
                         if (copying.policy == ReplaceOnce || copying.policy == ReplaceAll) {
                             fs::copy(entry.path(), target, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+                            discardCachedTotals(target);
                             successes.clipboards++;
                         }
                         break;
@@ -59,11 +320,17 @@ void importClipboards() {
                     fs::copy(entry.path(), target, fs::copy_options::recursive);
                     successes.clipboards++;
                 }
+                // exports carry a clipboard's cold tier in a directory of its own, which belongs under the persistent directory instead
+                if (auto cold = coldTierFor(entry.path().filename().string()); !cold.empty() && fs::is_directory(target / constants.cold_tier_directory)) {
+                    fs::copy(target / constants.cold_tier_directory, cold, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+                    removeRecursively(target / constants.cold_tier_directory);
+                }
             } catch (const fs::filesystem_error& e) {
                 copying.failedItems.emplace_back(entry.path().filename().string(), e.code());
             }
         }
     }
+    discardCatalog();
 }
 
 } // namespace PerformAction
\ No newline at end of file
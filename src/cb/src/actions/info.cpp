@@ -29,6 +29,20 @@
 
 namespace PerformAction {
 
+size_t totalClipboardSize() {
+    auto& manifest = path.manifest();
+    if (manifest.totals && manifest.totals->entries == path.totalEntries()) return manifest.totals->bytes;
+    auto bytes = path.totalSize();
+    manifest.totals = Manifest::Totals {path.totalEntries(), bytes};
+    path.saveManifest();
+    return bytes;
+}
+
+bool contentWasMovedIn() {
+    auto moved = movedItemsIn(path.metadata.moved);
+    return std::any_of(moved.begin(), moved.end(), [](const auto& item) { return item.first == path.entryIndex.at(path.entry()); });
+}
+
 void info() {
     stopIndicator();
     fprintf(stderr, "%s", formatColors("[info]┏━━[inverse] ").data());
@@ -55,11 +69,15 @@ void info() {
 
 #if defined(UNIX_OR_UNIX_LIKE)
     time_t latest = 0;
-    for (const auto& entry : fs::recursive_directory_iterator(path.data)) {
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(path.data, ec)) {
         struct stat info;
         stat(entry.path().string().data(), &info);
         if (info.st_ctime > latest) latest = info.st_ctime;
     }
+    // a segmented entry has no files of its own to look at
+    if (latest == 0 && path.segmentedEntry(path.entry()))
+        latest = std::chrono::system_clock::to_time_t(std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(path.entryWriteTime(path.entry()))));
     time = std::ctime(&latest);
     std::erase(time, '\n');
     fprintf(stderr, formatColors("[info]%s┃ Content last changed [help]%s[blank]\n").data(), endbar, time.data());
@@ -79,7 +97,7 @@ void info() {
     fprintf(stderr, formatColors("[info]%s┃ Persistent? [help]%s[blank]\n").data(), endbar, path.is_persistent ? "Yes" : "No");
 
     auto totalEntries = path.totalEntries();
-    auto totalSize = totalDirectorySize(path);
+    auto totalSize = totalClipboardSize();
     auto spaceAvailable = fs::space(path).available;
 
     fprintf(stderr, formatColors("[info]%s┃ Total entries: [help]%zu[blank]\n").data(), endbar, totalEntries);
@@ -88,12 +106,13 @@ void info() {
     fprintf(stderr, formatColors("[info]%s┃ Approx. entries remaining: [help]%s[blank]\n").data(), endbar, formatNumbers(spaceAvailable / (totalSize / totalEntries)).data());
 
     if (path.holdsRawDataInCurrentEntry()) {
-        fprintf(stderr, formatColors("[info]%s┃ Content size: [help]%s[blank]\n").data(), endbar, formatBytes(fs::file_size(path.data.raw)).data());
-        fprintf(stderr, formatColors("[info]%s┃ Content type: [help]%s[blank]\n").data(), endbar, inferMIMEType(fileContents(path.data.raw).value()).value_or("text/plain").data());
+        fprintf(stderr, formatColors("[info]%s┃ Content size: [help]%s[blank]\n").data(), endbar, formatBytes(rawDataSize(path.data.raw).value()).data());
+        fprintf(stderr, formatColors("[info]%s┃ Content type: [help]%s[blank]\n").data(), endbar, inferMIMEType(rawDataContents(path.data.raw, raw_preview_size).value()).value_or("text/plain").data());
     } else {
         size_t files = 0;
         size_t directories = 0;
         fprintf(stderr, formatColors("[info]%s┃ Content size: [help]%s[blank]\n").data(), endbar, formatBytes(totalDirectorySize(path.data)).data());
+        fprintf(stderr, formatColors("[info]%s┃ Space on disk: [help]%s[blank]\n").data(), endbar, formatBytes(totalDirectorySize(path.data, true)).data());
         for (const auto& entry : fs::directory_iterator(path.data))
             entry.is_directory() ? directories++ : files++;
         fprintf(stderr, formatColors("[info]%s┃ Files: [help]%zu[blank]\n").data(), endbar, files);
@@ -108,7 +127,7 @@ void info() {
         }
         fprintf(stderr, "%s", formatColors("[blank]\n").data());
     }
-    fprintf(stderr, formatColors("[info]%s┃ Content cut? [help]%s[blank]\n").data(), endbar, fs::exists(path.metadata.originals) ? "Yes" : "No");
+    fprintf(stderr, formatColors("[info]%s┃ Content cut? [help]%s[blank]\n").data(), endbar, fs::exists(path.metadata.originals) || contentWasMovedIn() ? "Yes" : "No");
 
     fprintf(stderr, formatColors("[info]%s┃ Locked by another process? [help]%s[blank]\n").data(), endbar, path.isLocked() ? "Yes" : "No");
 
@@ -116,14 +135,14 @@ void info() {
         fprintf(stderr, formatColors("[info]%s┃ Locked by process with pid [help]%s[blank]\n").data(), endbar, fileContents(path.metadata.lock).value().data());
     }
 
-    if (fs::exists(path.metadata.notes))
-        fprintf(stderr, formatColors("[info]%s┃ Note: [help]%s[blank]\n").data(), endbar, fileContents(path.metadata.notes).value().data());
+    if (path.manifest().notes)
+        fprintf(stderr, formatColors("[info]%s┃ Note: [help]%s[blank]\n").data(), endbar, path.manifest().notes->data());
     else
         fprintf(stderr, formatColors("[info]%s┃ There is no note for this clipboard.[blank]\n").data(), endbar);
 
     if (path.holdsIgnoreRegexes()) {
         fprintf(stderr, formatColors("[info]%s┃ Ignore regexes: [help]").data(), endbar);
-        auto regexes = fileLines(path.metadata.ignore);
+        auto regexes = contentLines(path.manifest().ignore.value());
         for (const auto& regex : regexes) {
             fprintf(stderr, "%s", regex.data());
             if (regex != regexes.back()) fprintf(stderr, ", ");
@@ -132,23 +151,23 @@ void info() {
     } else
         fprintf(stderr, formatColors("[info]%s┃ There are no ignore regexes for this clipboard.[blank]\n").data(), endbar);
 
-    if (fs::exists(path.metadata.ignore_secret)) {
+    if (path.manifest().ignore_secret) {
         // list only how many ignore secrets there are
-        auto secrets = fileLines(path.metadata.ignore_secret);
+        auto secrets = contentLines(path.manifest().ignore_secret.value());
         fprintf(stderr, formatColors("[info]%s┃ There are %zu ignore secrets for this clipboard.[blank]\n").data(), endbar, secrets.size());
     } else {
         fprintf(stderr, formatColors("[info]%s┃ There are no ignore secrets for this clipboard.[blank]\n").data(), endbar);
     }
 
-    if (fs::exists(path.metadata.script)) {
+    if (path.holdsScript()) {
         auto script = fileContents(path.metadata.script).value();
         if (script.size() > 50) {
             fprintf(stderr, formatColors("[info]%s┃ Script preview: [help]%s...[blank]\n").data(), endbar, makeControlCharactersVisible(removeExcessWhitespace(script.substr(0, 50))).data());
         } else {
             fprintf(stderr, formatColors("[info]%s┃ Script preview: [help]%s[blank]\n").data(), endbar, makeControlCharactersVisible(removeExcessWhitespace(script)).data());
         }
-        auto lines  = fileLines(path.metadata.script_config, true);
-        if (lines[0] != "") {
+        auto lines = contentLines(path.manifest().script_config.value_or(""), true);
+        if (!lines.empty() && lines[0] != "") {
             fprintf(stderr, formatColors("[info]%s┃ Script actions: [help]").data(), endbar);
             for (const auto& action : regexSplit(lines[0], std::regex(" "))) {
                 fprintf(stderr, "%s", action.data());
@@ -196,11 +215,15 @@ void infoJSON() {
 
 #if defined(UNIX_OR_UNIX_LIKE)
     time_t latest = 0;
-    for (const auto& entry : fs::recursive_directory_iterator(path.data)) {
+    std::error_code ec;
+    for (const auto& entry : fs::recursive_directory_iterator(path.data, ec)) {
         struct stat info;
         stat(entry.path().string().data(), &info);
         if (info.st_ctime > latest) latest = info.st_ctime;
     }
+    // a segmented entry has no files of its own to look at
+    if (latest == 0 && path.segmentedEntry(path.entry()))
+        latest = std::chrono::system_clock::to_time_t(std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(path.entryWriteTime(path.entry()))));
     time = std::ctime(&latest);
     std::erase(time, '\n');
     printf("    \"contentLastChanged\": \"%s\",\n", time.data());
@@ -218,7 +241,7 @@ void infoJSON() {
 #endif
 
     auto totalEntries = path.totalEntries();
-    auto totalSize = totalDirectorySize(path);
+    auto totalSize = totalClipboardSize();
     auto spaceAvailable = fs::space(path).available;
 
     printf("    \"isPersistent\": %s,\n", path.is_persistent ? "true" : "false");
@@ -228,14 +251,15 @@ void infoJSON() {
     printf("    \"approxEntriesRemaining\": %zu,\n", spaceAvailable / (totalSize / totalEntries));
 
     if (path.holdsRawDataInCurrentEntry()) {
-        printf("    \"contentBytes\": %zu,\n", fs::file_size(path.data.raw));
-        printf("    \"contentType\": \"%s\",\n", inferMIMEType(fileContents(path.data.raw).value()).value_or("text/plain").data());
+        printf("    \"contentBytes\": %zu,\n", rawDataSize(path.data.raw).value());
+        printf("    \"contentType\": \"%s\",\n", inferMIMEType(rawDataContents(path.data.raw, raw_preview_size).value()).value_or("text/plain").data());
     } else {
         size_t files = 0;
         size_t directories = 0;
         for (const auto& entry : fs::directory_iterator(path.data))
             entry.is_directory() ? directories++ : files++;
         printf("    \"contentBytes\": %zu,\n", totalDirectorySize(path.data));
+        printf("    \"allocatedBytes\": %zu,\n", totalDirectorySize(path.data, true));
         printf("    \"files\": %zu,\n", files);
         printf("    \"directories\": %zu,\n", directories);
     }
@@ -247,19 +271,19 @@ void infoJSON() {
         printf("],\n");
     }
 
-    printf("    \"contentCut\": %s,\n", fs::exists(path.metadata.originals) ? "true" : "false");
+    printf("    \"contentCut\": %s,\n", fs::exists(path.metadata.originals) || contentWasMovedIn() ? "true" : "false");
 
     printf("    \"locked\": %s,\n", path.isLocked() ? "true" : "false");
     if (path.isLocked()) printf("    \"lockedBy\": \"%s\",\n", fileContents(path.metadata.lock).value().data());
 
-    if (fs::exists(path.metadata.notes))
-        printf("    \"note\": \"%s\",\n", JSONescape(fileContents(path.metadata.notes).value()).data());
+    if (path.manifest().notes)
+        printf("    \"note\": \"%s\",\n", JSONescape(path.manifest().notes.value()).data());
     else
         printf("    \"note\": null,\n");
 
     if (path.holdsIgnoreRegexes()) {
         printf("    \"ignoreRegexes\": [");
-        auto regexes = fileLines(path.metadata.ignore);
+        auto regexes = contentLines(path.manifest().ignore.value());
         for (const auto& regex : regexes)
             printf("\"%s\"%s", JSONescape(regex).data(), regex != regexes.back() ? ", " : "");
         printf("]\n");
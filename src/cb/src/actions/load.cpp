@@ -14,6 +14,7 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
+#include <map>
 
 namespace PerformAction {
 
@@ -34,29 +35,119 @@ void load() {
                 formatColors("[error][inverse] ✘ [noinverse] You can't load a clipboard into itself. [help]⬤ Try choosing a different source instead, or choose different destinations.[blank]\n")
         );
 
+    // Walk the source entry once and share the result with every destination
+    struct PlannedItem {
+        fs::path source;
+        fs::path relative;
+        fs::file_type type;
+    };
+    std::vector<PlannedItem> plan;
+    for (const auto& entry : fs::recursive_directory_iterator(path.data))
+        plan.push_back({entry.path(), entry.path().lexically_relative(path.data), entry.symlink_status().type()});
+
+    struct FilteredPlan {
+        std::vector<bool> skip;
+        std::optional<std::string> raw;
+    };
+
+    bool sourceHoldsRawData = path.holdsRawDataInCurrentEntry();
+
+    // Destinations usually share the same ignore rules (most often none at all), so evaluate each distinct set of rules against the source only once
+    auto filteredPlanFor = [&](Clipboard& destination) {
+        FilteredPlan filtered;
+        filtered.skip.resize(plan.size(), false);
+        const auto& rules = destination.ignoreRules();
+        if (sourceHoldsRawData && rules.hasRegexes()) {
+            auto content = rules.filtered(rawDataContents(path.data.raw).value());
+            if (rules.isSecret(content)) content.clear();
+            filtered.raw = std::move(content);
+        } else if (sourceHoldsRawData && rules.hasSecrets()) {
+            if (rules.isSecretData(path.data.raw)) filtered.raw = ""; // otherwise the stored data is copied untouched
+        } else if (!sourceHoldsRawData && rules.hasRegexes()) {
+            for (size_t i = 0; i < plan.size(); i++)
+                filtered.skip.at(i) = rules.ignores(plan.at(i).relative.begin()->string());
+        }
+        return filtered;
+    };
+
+    std::vector<Clipboard> targets;
+    std::vector<std::shared_ptr<FilteredPlan>> targetPlans;
+    std::map<std::string, std::shared_ptr<FilteredPlan>> plansByRules;
+    deduplicate(destinations); // two workers filling the same clipboard would trip over each other
     for (const auto& destination_number : destinations) {
-        Clipboard destination(destination_number);
         try {
-            for (const auto& entry : fs::directory_iterator(path.data)) {
-                auto target = destination.data / entry.path().filename();
-                auto loadItem = [&](bool use_regular_copy = copying.use_safe_copy) {
-                    if (entry.is_directory())
-                        fs::copy(entry.path(), target, copying.opts);
-                    else
-                        fs::copy(entry.path(), target, use_regular_copy ? copying.opts : (copying.opts | fs::copy_options::create_hard_links));
-                };
-                try {
-                    loadItem();
-                } catch (const fs::filesystem_error& e) {
-                    if (!copying.use_safe_copy && e.code() == std::errc::cross_device_link) loadItem(true);
+            auto& destination = targets.emplace_back(destination_number);
+            auto rules = destination.manifest().ignore.value_or("") + '\0' + destination.manifest().ignore_secret.value_or("");
+            auto& filtered = plansByRules[rules];
+            if (!filtered) filtered = std::make_shared<FilteredPlan>(filteredPlanFor(destination));
+            targetPlans.emplace_back(filtered);
+        } catch (const fs::filesystem_error& e) {
+            copying.failedItems.emplace_back(destination_number, e.code());
+        }
+    }
+
+    std::mutex failedItemsMutex;
+
+    // the journal, manifest, and catalog are shared between clipboards, so only the copying itself happens on the workers
+    std::vector<char> loaded(targets.size(), false);
+    for (size_t i = 0; i < targets.size(); i++) {
+        try {
+            targets.at(i).stageEntryChange(); // which also keeps what's replaced for undoing once it's published
+            loaded.at(i) = true;
+        } catch (const fs::filesystem_error& e) {
+            copying.failedItems.emplace_back(targets.at(i).name(), e.code());
+        }
+    }
+
+    auto loadInto = [&](Clipboard& destination, const FilteredPlan& filtered) {
+        try {
+            for (size_t i = 0; i < plan.size(); i++) {
+                if (filtered.skip.at(i)) continue;
+                const auto& item = plan.at(i);
+                auto target = destination.data / item.relative;
+                if (filtered.raw && isRawDataFile(item.relative)) {
+                    writeRawData(destination.data.raw, filtered.raw.value());
+                } else if (item.type == fs::file_type::directory) {
+                    createDirectories(target);
+                } else if (item.type == fs::file_type::symlink) {
+                    std::error_code ec;
+                    fs::remove(target, ec);
+                    fs::copy_symlink(item.source, target);
+                } else {
+                    cowCopyFile(item.source, target, copying.use_safe_copy);
                 }
             }
+            return true;
+        } catch (const fs::filesystem_error& e) {
+            std::lock_guard<std::mutex> lock(failedItemsMutex);
+            copying.failedItems.emplace_back(destination.name(), e.code());
+            return false;
+        }
+    };
+
+    std::atomic<size_t> nextTarget = 0;
+    auto loadWorker = [&] {
+        for (size_t i = nextTarget++; i < targets.size(); i = nextTarget++)
+            if (loaded.at(i)) loaded.at(i) = loadInto(targets.at(i), *targetPlans.at(i));
+    };
 
-            destination.applyIgnoreRules();
+    std::vector<std::thread> workers(std::min<size_t>(suitableThreadAmount(), targets.size()));
+    for (auto& worker : workers)
+        worker = std::thread(loadWorker);
+    for (auto& worker : workers)
+        worker.join();
 
+    for (size_t i = 0; i < targets.size(); i++) {
+        if (!loaded.at(i)) {
+            targets.at(i).discardStagedEntry();
+            continue;
+        }
+        try {
+            targets.at(i).publishEntry();
+            targets.at(i).markContentChanged();
             successes.clipboards++;
         } catch (const fs::filesystem_error& e) {
-            copying.failedItems.emplace_back(destination_number, e.code());
+            copying.failedItems.emplace_back(targets.at(i).name(), e.code());
         }
     }
 
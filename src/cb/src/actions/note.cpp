@@ -20,23 +20,26 @@ namespace PerformAction {
 void noteText() {
     if (copying.items.size() >= 1) {
         if (copying.items.at(0).string() == "") {
-            fs::remove(path.metadata.notes);
+            path.manifest().notes.reset();
+            path.saveManifest();
             if (output_silent || confirmation_silent) return;
             stopIndicator();
             fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Removed note[blank]\n").data());
         } else {
-            fs::remove(path.metadata.notes);
+            std::string content;
             for (size_t i = 0; i < copying.items.size(); i++) {
-                writeToFile(path.metadata.notes, copying.items.at(i).string(), true);
-                if (i != copying.items.size() - 1) writeToFile(path.metadata.notes, " ", true);
+                content += copying.items.at(i).string();
+                if (i != copying.items.size() - 1) content += " ";
             }
+            path.manifest().notes = content;
+            path.saveManifest();
             if (output_silent || confirmation_silent) return;
             stopIndicator();
-            fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Saved note \"%s\"[blank]\n").data(), fileContents(path.metadata.notes).value().data());
+            fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Saved note \"%s\"[blank]\n").data(), content.data());
         }
     } else if (copying.items.empty()) {
-        if (fs::is_regular_file(path.metadata.notes)) {
-            std::string content(fileContents(path.metadata.notes).value());
+        if (path.manifest().notes) {
+            std::string content(path.manifest().notes.value());
             if (is_tty.out) {
                 stopIndicator();
                 printf(formatColors("[info]┃ Note for this clipboard: %s[blank]\n").data(), content.data());
@@ -52,7 +55,8 @@ void noteText() {
 
 void notePipe() {
     std::string content(pipedInContent());
-    writeToFile(path.metadata.notes, content);
+    path.manifest().notes = content;
+    path.saveManifest();
     if (output_silent || confirmation_silent) return;
     stopIndicator();
     fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Saved note \"%s\"[blank]\n").data(), content.data());
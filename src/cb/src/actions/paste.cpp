@@ -14,6 +14,8 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
+#include <fstream>
+#include <set>
 
 namespace PerformAction {
 
@@ -28,19 +30,45 @@ void paste() {
         std::transform(splitted.begin(), splitted.end(), std::back_inserter(regexes), [](const auto& item) { return std::regex(item); });
     }
 
-    for (const auto& entry : fs::directory_iterator(path.data)) {
+    // cut items leave the clipboard when they're pasted anyway, so they can be moved out instead of copied
+    std::set<std::string> cutItems;
+    if (fs::is_regular_file(path.metadata.originals))
+        for (const auto& line : fileLines(path.metadata.originals))
+            cutItems.emplace(fs::path(line).filename().string());
+    // only this entry's moved items, since a later copy of something with the same name has to stay where it is
+    for (const auto& [entry, original] : movedItemsIn(path.metadata.moved))
+        if (entry == path.entryIndex.at(path.entry())) cutItems.emplace(original.filename().string());
+    if (!cutItems.empty()) path.getLock();
+
+    // a segmented entry has no directory, only raw data that gets read out of its segment
+    std::vector<fs::directory_entry> items;
+    if (path.segmentedEntry(path.entry()))
+        items.emplace_back(path.data.raw);
+    else
+        items.assign(fs::directory_iterator(path.data), fs::directory_iterator {});
+
+    for (const auto& entry : items) {
         auto target = [&] {
             if (path.holdsRawDataInCurrentEntry())
                 return (fs::current_path() / ("clipboard" + clipboard_name + "-" + std::to_string(clipboard_entry)))
-                        .replace_extension(inferFileExtension(fileContents(path.data.raw).value()).value_or(".txt"));
+                        .replace_extension(inferFileExtension(rawDataContents(path.data.raw, raw_preview_size).value()).value_or(".txt"));
             else
                 return fs::current_path() / entry.path().filename();
         }();
         auto pasteItem = [&](const bool use_regular_copy = copying.use_safe_copy) {
-            if (!(fs::exists(target) && fs::equivalent(entry, target))) {
-                fs::copy(entry, target, use_regular_copy || entry.is_directory() ? copying.opts : copying.opts | fs::copy_options::create_hard_links);
+            if (isRawDataFile(entry.path()) && (storedRawData(path.data.raw).second != Codec::None || !entry.exists())) {
+                std::ofstream output(target, std::ios::binary | std::ios::trunc);
+                streamRawData(path.data.raw, [&](const std::string_view& chunk) {
+                    output.write(chunk.data(), chunk.size());
+                    return true;
+                });
+            } else if (!(fs::exists(target) && fs::equivalent(entry, target))) {
+                auto movable = cutItems.contains(entry.path().filename().string()) && !isRawDataFile(entry.path());
+                std::error_code ec;
+                if (movable) renamePath(entry, target, ec); // fails across filesystems, and onto a directory that isn't empty
+                if (!movable || ec) cowCopy(entry, target, use_regular_copy || entry.is_directory());
             }
-            incrementSuccessesForItem(entry);
+            incrementSuccessesForItem(target); // the entry could have been moved away already
         };
         if (!regexes.empty() && !std::any_of(regexes.begin(), regexes.end(), [&](const auto& regex) {
                 return std::regex_match(entry.path().filename().string(), regex) || std::regex_match(entry.path().string(), regex);
@@ -24,14 +24,37 @@
 namespace PerformAction {
 
 void pipeIn() {
-    copying.buffer = pipedInContent();
-    writeToFile(path.data.raw, copying.buffer);
+    if (archive_mode) {
+        try {
+            successes.bytes += readArchive(fileno(stdin), path.data);
+        } catch (const std::exception& e) {
+            error_exit(formatColors("[error][inverse] ✘ [noinverse] CB couldn't unpack the archive because %s. [help]⬤ Try piping in a tar archive instead.[blank]\n"), std::string(e.what()));
+        }
+        return;
+    }
+    // ignore rules only apply once everything's in, so with any set, nobody gets to see the content before then
+    // and compressing needs to see the content first, so only uncompressed entries can fill up in place
+    if (configuredCodec() == Codec::None && path.ignoreRules().empty() && arrivesGradually(fileno(stdin))) {
+        // a slow producer could take a while, so the entry goes up right away and fills up where everyone can see it
+        struct InProgress {
+            bool finished = false;
+            ~InProgress() {
+                if (!finished) path.abandonEntryInProgress();
+            }
+        } inProgress;
+        path.publishEntryInProgress();
+        appendIntoFile(fileno(stdin), path.data.raw, tee_output);
+        path.finishEntryInProgress();
+        inProgress.finished = true;
+    } else {
+        copying.buffer = pipedInContent(true, tee_output);
+        writeRawData(path.data.raw, copying.buffer);
+    }
     if (action == Action::Cut) writeToFile(path.metadata.originals, path.data.raw.string());
 }
 
 void pipeOut() {
-    for (const auto& entry : fs::recursive_directory_iterator(path.data)) {
-        std::string content(fileContents(entry.path()).value());
+    auto writeOut = [](const std::string_view& content) {
 #if !defined(_WIN32) && !defined(_WIN64)
         int len = write(fileno(stdout), content.data(), content.size());
         if (len < 0) throw std::runtime_error("write() failed");
@@ -39,9 +62,28 @@ void pipeOut() {
         _setmode(_fileno(stdout), _O_BINARY);
         fwrite(content.data(), sizeof(char), content.size(), stdout);
 #endif
-        fflush(stdout);
         successes.bytes += content.size();
-    }
+        return true;
+    };
+    if (follow_output && path.entryInProgress()) {
+        // what's there already goes out first, and then whatever the writer adds until it's done
+        followFile(path.data.raw, [] { return path.entryInProgress(); }, writeOut);
+        fflush(stdout);
+    } else if (archive_mode && !path.holdsRawDataInCurrentEntry()) {
+        // the items keep their names and structure, which concatenating them would lose
+        successes.bytes += writeArchive(path.data, fileno(stdout));
+    } else if (path.holdsRawDataInCurrentEntry()) {
+        // stream raw data chunk by chunk so compressed entries never need to be held in memory all at once
+        streamRawData(path.data.raw, writeOut);
+        fflush(stdout);
+    } else
+        for (const auto& entry : fs::recursive_directory_iterator(path.data)) {
+            if (isRawDataFile(entry.path()))
+                streamRawData(path.data.raw, writeOut);
+            else if (entry.is_regular_file())
+                streamFile(entry.path(), writeOut);
+            fflush(stdout);
+        }
     removeOldFiles();
 }
 
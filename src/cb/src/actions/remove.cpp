@@ -25,7 +25,7 @@ void removeRegex() {
         std::transform(copying.items.begin(), copying.items.end(), std::back_inserter(regexes), [](const auto& item) { return std::regex(item.string()); });
 
     if (path.holdsRawDataInCurrentEntry()) {
-        std::string content(fileContents(path.data.raw).value());
+        std::string content(rawDataContents(path.data.raw).value());
         size_t oldLength = content.size();
 
         for (const auto& pattern : regexes)
@@ -33,7 +33,7 @@ void removeRegex() {
         successes.bytes += oldLength - content.size();
 
         if (oldLength != content.size())
-            writeToFile(path.data.raw, content);
+            writeRawData(path.data.raw, content);
         else
             error_exit(
                     "%s",
@@ -45,7 +45,7 @@ void removeRegex() {
             for (const auto& pattern : regexes) {
                 if (std::regex_match(entry.path().filename().string(), pattern)) {
                     try {
-                        fs::remove_all(entry.path());
+                        removeRecursively(entry.path());
                         incrementSuccessesForItem(entry.path());
                     } catch (const fs::filesystem_error& e) {
                         copying.failedItems.emplace_back(entry.path().filename().string(), e.code());
@@ -33,7 +33,8 @@ void script() {
         dataToWrite += timing + " ";
     }
     if (dataToWrite.back() == ' ') dataToWrite.back() = '\n'; else dataToWrite += '\n';
-    writeToFile(path.metadata.script_config, dataToWrite);
+    path.manifest().script_config = dataToWrite;
+    path.saveManifest();
     checkClipboardScriptEligibility();
     if (io_type == IOType::File) {
         if (copying.items.size() > 1) {
@@ -42,7 +43,7 @@ void script() {
         }
         if (copying.items.empty()) {
             stopIndicator();
-            if (fs::is_regular_file(path.metadata.script)) {
+            if (path.holdsScript()) {
                 fprintf(stderr, formatColors("[info]┃ Here is this clipboard's current script: [help]%s[blank]\n").data(), fileContents(path.metadata.script).value().data());
             } else {
 
@@ -57,16 +58,17 @@ void script() {
             }
             return;
         }
-        fs::remove(path.metadata.script);
+        removeRecursively(path.metadata.script);
         fs::copy(copying.items.at(0), path.metadata.script);
         fs::permissions(path.metadata.script, fs::perms::owner_exec, fs::perm_options::add);
+        forgetCachedStatus(path.metadata.script);
 
         if (output_silent || confirmation_silent) return;
         stopIndicator();
         fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Saved script \"%s\"[blank]\n").data(), fileContents(path.metadata.script).value().data());
     } else if (io_type == IOType::Text) {
         if (copying.items.at(0).string() == "") {
-            fs::remove(path.metadata.script);
+            removeRecursively(path.metadata.script);
             if (output_silent || confirmation_silent) return;
             stopIndicator();
             fprintf(stderr, "%s", formatColors("[success][inverse] ✔ [noinverse] Removed script[blank]\n").data());
@@ -75,7 +77,7 @@ void script() {
                 copying.buffer += copying.items.at(i).string();
                 if (i != copying.items.size() - 1) copying.buffer += " ";
             }
-            fs::remove(path.metadata.script);
+            removeRecursively(path.metadata.script);
             writeToFile(path.metadata.script, copying.buffer);
             fs::permissions(path.metadata.script, fs::perms::owner_exec, fs::perm_options::add);
             if (output_silent || confirmation_silent) return;
@@ -92,7 +94,7 @@ void runClipboardScript() {
     //std::cout << "Run before: " << runBefore << std::endl;
     //std::cout << "Run after: " << runAfter << std::endl;
 
-    if (!fs::is_regular_file(path.metadata.script)) return;
+    if (!path.holdsScript()) return;
 
 #if defined(_WIN32) || defined(_WIN64)
     fprintf(stderr, "%s", formatColors("[error][inverse] ✘ [noinverse] Sorry, but clipboard scripts aren't supported on Windows yet.[blank]\n").data());
@@ -115,6 +117,7 @@ void runClipboardScript() {
         if (res != 0) fprintf(stderr, "%s", formatColors("[error][inverse] ✘ [noinverse] Failed to set the CLIPBOARD_SCRIPT_TIMING environment variable[blank]\n").data());
 
         res = system(path.metadata.script.string().c_str());
+        forgetCachedStatuses(); // the script could have changed anything, and it runs from another directory
         if (res != 0) {
             res = WEXITSTATUS(res);
             fprintf(stderr, formatColors("[error][inverse] ✘ [noinverse] Failed to run the clipboard script (returned exit code [bold]%d[nobold])[blank]\n").data(), res);
@@ -136,9 +139,9 @@ void runClipboardScript() {
 }
 
 void checkClipboardScriptEligibility() {
-    if (!fs::is_regular_file(path.metadata.script_config)) return;
+    if (!path.manifest().script_config) return;
 
-    auto lines = fileLines(path.metadata.script_config, true);
+    auto lines = contentLines(path.manifest().script_config.value(), true);
 
     if (lines.empty()) return;
 
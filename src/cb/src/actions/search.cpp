@@ -103,10 +103,9 @@ void searchInternal(std::function<void(const std::vector<Result>&)> nextStep) {
     std::hash<unsigned long> hashULong;
 
     if (all_option) {
-        for (const auto& entry : fs::directory_iterator(global_path.temporary))
-            if (auto cb = Clipboard(entry.path().filename().string()); cb.holdsData()) targets.emplace_back(cb);
-        for (const auto& entry : fs::directory_iterator(global_path.persistent))
-            if (auto cb = Clipboard(entry.path().filename().string()); cb.holdsData()) targets.emplace_back(cb);
+        // the catalog already knows which clipboards are empty or can't hold a match, so those never get opened
+        for (const auto& record : catalogRecords())
+            if (record.holds_data && std::any_of(queries.begin(), queries.end(), [&](const auto& query) { return record.mightMatch(query); })) targets.emplace_back(record.name);
     } else
         targets.emplace_back(path);
 
@@ -150,20 +149,16 @@ void searchInternal(std::function<void(const std::vector<Result>&)> nextStep) {
     };
 
     for (auto& clipboard : targets) {
-        for (auto entry = 0; entry < clipboard.entryIndex.size(); entry++) {
-            auto adjustScoreByEntryPosition = [&](Result& result) {
-                float multiplier = 1.0f - (static_cast<float>(entry) / (20.0f * static_cast<float>(clipboard.entryIndex.size())));
-                float newScore = static_cast<float>(result.score) * multiplier;
-                result.score = static_cast<unsigned long>(newScore);
-            };
+        auto firstResult = results.size();
+        for (unsigned long entry = 0; entry < clipboard.entryIndex.size() || clipboard.listNextShard(); entry++) {
             clipboard.setEntry(entry);
             if (clipboard.holdsRawDataInCurrentEntry()) {
+                auto content = rawDataContents(clipboard.data.raw).value();
                 for (const auto& query : queries) {
-                    if (auto rating = contentMatchRating(fileContents(clipboard.data.raw).value(), query); rating.has_value()) {
+                    if (auto rating = contentMatchRating(content, query); rating.has_value()) {
                         rating->clipboard = clipboard.name();
                         rating->entry = entry;
                         rating->hash = combineHashes(hashString(clipboard.name()), hashULong(entry));
-                        adjustScoreByEntryPosition(rating.value());
                         results.emplace_back(rating.value());
                     }
                 }
@@ -174,13 +169,18 @@ void searchInternal(std::function<void(const std::vector<Result>&)> nextStep) {
                             rating->clipboard = clipboard.name();
                             rating->entry = entry;
                             rating->hash = combineHashes(hashString(clipboard.name()), hashULong(entry));
-                            adjustScoreByEntryPosition(rating.value());
                             results.emplace_back(rating.value());
                         }
                     }
                 }
             }
         }
+        // how far back an entry is only becomes known once the walk has listed every shard
+        for (auto result = results.begin() + firstResult; result != results.end(); result++) {
+            float multiplier = 1.0f - (static_cast<float>(result->entry) / (20.0f * static_cast<float>(clipboard.entryIndex.size())));
+            float newScore = static_cast<float>(result->score) * multiplier;
+            result->score = static_cast<unsigned long>(newScore);
+        }
     }
 
     if (results.empty())
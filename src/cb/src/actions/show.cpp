@@ -27,13 +27,25 @@ void show() {
 
     auto available = thisTerminalSize();
 
+    if (follow_output && path.entryInProgress()) {
+        // a preview would only ever show the start, so show everything as it comes in instead
+        fprintf(stderr, "%s", formatColors("[bold][info]").data());
+        followFile(path.data.raw, [] { return path.entryInProgress(); }, [](const std::string_view& chunk) {
+            fwrite(chunk.data(), sizeof(char), chunk.size(), stderr);
+            return true;
+        });
+        fprintf(stderr, "%s", formatColors("[blank]").data());
+        return;
+    }
+
     if (path.holdsRawDataInCurrentEntry()) {
-        std::string content(fileContents(path.data.raw).value());
+        std::string content(rawDataContents(path.data.raw, raw_preview_size).value());
+        auto totalSize = rawDataSize(path.data.raw).value();
         content = makeControlCharactersVisible(content, available.columns);
         fprintf(stderr, clipboard_text_contents_message().data(), std::min(static_cast<size_t>(250), content.size()), clipboard_name.data());
         fprintf(stderr, formatColors("[bold][info]%s\n[blank]").data(), content.substr(0, 250).data());
-        if (content.size() > 250) {
-            fprintf(stderr, and_more_items_message().data(), content.size() - 250);
+        if (totalSize > 250) {
+            fprintf(stderr, and_more_items_message().data(), totalSize - 250);
         }
         return;
     }
@@ -74,7 +86,8 @@ void showFilepaths() {
         std::transform(copying.items.begin(), copying.items.end(), std::back_inserter(regexes), [](const auto& item) { return std::regex(item.string()); });
     }
 
-    std::vector<fs::path> paths(fs::directory_iterator(path.data), fs::directory_iterator {});
+    std::error_code ec; // a segmented entry has no files to show the paths of
+    std::vector<fs::path> paths(fs::directory_iterator(path.data, ec), fs::directory_iterator {});
     if (!regexes.empty())
         paths.erase(
                 std::remove_if(
@@ -17,15 +17,13 @@
 
 namespace PerformAction {
 
-std::vector<Clipboard> clipboardsWithContent() {
-    std::vector<Clipboard> clipboards;
-    for (const auto& entry : fs::directory_iterator(global_path.temporary))
-        if (auto cb = Clipboard(entry.path().filename().string()); cb.holdsDataInCurrentEntry()) clipboards.emplace_back(cb);
-    for (const auto& entry : fs::directory_iterator(global_path.persistent))
-        if (auto cb = Clipboard(entry.path().filename().string()); cb.holdsDataInCurrentEntry()) clipboards.emplace_back(cb);
-    std::sort(clipboards.begin(), clipboards.end(), [](const auto& a, const auto& b) { return a.name() < b.name(); });
-    clipboards.erase(std::unique(clipboards.begin(), clipboards.end(), [](const auto& a, const auto& b) { return a.name() == b.name(); }), clipboards.end());
-    return clipboards;
+std::vector<CatalogRecord> clipboardsWithContent() {
+    auto records = catalogRecords();
+    // a clipboard removed by hand drops out of the catalog the next time it's looked at
+    std::erase_if(records, [](const auto& record) {
+        return record.kind == CatalogRecord::Preview::Empty || !cachedStatus((record.persistent ? global_path.persistent : global_path.temporary) / record.name).exists;
+    });
+    return records;
 }
 
 void status() {
@@ -38,7 +36,7 @@ void status() {
         return;
     }
     auto longestClipboardLength =
-            (*std::max_element(clipboards_with_contents.begin(), clipboards_with_contents.end(), [](const auto& a, const auto& b) { return a.name().size() < b.name().size(); })).name().size();
+            (*std::max_element(clipboards_with_contents.begin(), clipboards_with_contents.end(), [](const auto& a, const auto& b) { return a.name.size() < b.name.size(); })).name.size();
     auto available = thisTerminalSize();
 
     stopIndicator();
@@ -49,26 +47,25 @@ void status() {
     int columns = available.columns - (columnLength(check_clipboard_status_message) + 7);
     fprintf(stderr, "%s%s", repeatString("━", columns).data(), formatColors("┓[blank]\n").data());
 
-    for (auto& clipboard : clipboards_with_contents) {
-        clipboard.getLock();
-
-        int widthRemaining = available.columns - (clipboard.name().length() + 5 + longestClipboardLength);
-        fprintf(stderr, formatColors("[info]\033[%ldG┃\r┃ [bold]%*s%s[nobold]│ [blank]").data(), available.columns, longestClipboardLength - clipboard.name().length(), "", clipboard.name().data());
+    for (const auto& clipboard : clipboards_with_contents) {
+        int widthRemaining = available.columns - (clipboard.name.length() + 5 + longestClipboardLength);
+        fprintf(stderr, formatColors("[info]\033[%ldG┃\r┃ [bold]%*s%s[nobold]│ [blank]").data(), available.columns, longestClipboardLength - clipboard.name.length(), "", clipboard.name.data());
 
-        if (clipboard.holdsRawDataInCurrentEntry()) {
-            std::string content(fileContents(clipboard.data.raw).value());
-            if (auto type = inferMIMEType(content); type.has_value())
-                content = "\033[7m\033[1m " + std::string(type.value()) + ", " + formatBytes(content.length()) + " \033[22m\033[27m";
+        if (clipboard.kind != CatalogRecord::Preview::Files) {
+            std::string content;
+            if (clipboard.kind == CatalogRecord::Preview::Data)
+                content = "\033[7m\033[1m " + clipboard.preview + " \033[22m\033[27m";
             else
-                content = removeExcessWhitespace(content, available.columns * 2);
+                content = removeExcessWhitespace(clipboard.preview, available.columns * 2);
             content = makeControlCharactersVisible(content, available.columns);
             fprintf(stderr, formatColors("[help]%s[blank]\n").data(), content.substr(0, widthRemaining).data());
-            clipboard.releaseLock();
             continue;
         }
 
-        for (bool first = true; const auto& entry : fs::directory_iterator(clipboard.data)) {
-            int entryWidth = entry.path().filename().string().length();
+        for (bool first = true; const auto& entry : contentLines(clipboard.preview)) {
+            auto isDirectory = entry.front() == 'd';
+            auto filename = entry.substr(1);
+            int entryWidth = filename.length();
 
             if (widthRemaining <= 0) break;
 
@@ -81,16 +78,15 @@ void status() {
 
             if (entryWidth <= widthRemaining) {
                 std::string stylizedEntry;
-                if (entry.is_directory())
-                    stylizedEntry = "\033[4m" + entry.path().filename().string() + "\033[24m";
+                if (isDirectory)
+                    stylizedEntry = "\033[4m" + filename + "\033[24m";
                 else
-                    stylizedEntry = "\033[1m" + entry.path().filename().string() + "\033[22m";
+                    stylizedEntry = "\033[1m" + filename + "\033[22m";
                 fprintf(stderr, formatColors("[help]%s[blank]").data(), stylizedEntry.data());
                 widthRemaining -= entryWidth;
                 first = false;
             }
         }
-        clipboard.releaseLock();
         fprintf(stderr, "\n");
     }
     fprintf(stderr, "%s", formatColors("[info]┗━━▌").data());
@@ -106,20 +102,22 @@ void statusJSON() {
 
     auto clipboards_with_contents = clipboardsWithContent();
 
-    for (const auto& clipboard : clipboards_with_contents) {
+    for (const auto& record : clipboards_with_contents) {
+        // JSON output has the whole content rather than a preview, so only this part opens the clipboards themselves
+        Clipboard clipboard(record.name);
 
         printf("    \"%s\": ", clipboard.name().data());
 
         if (clipboard.holdsRawDataInCurrentEntry()) {
-            std::string content(fileContents(clipboard.data.raw).value());
+            std::string content(rawDataContents(clipboard.data.raw, raw_preview_size).value());
             if (auto type = inferMIMEType(content); type.has_value()) {
                 printf("{\n");
                 printf("        \"dataType\": \"%s\",\n", type.value().data());
-                printf("        \"dataSize\": %zu,\n", content.length());
-                printf("        \"path\": \"%s\"\n", clipboard.data.raw.string().data());
+                printf("        \"dataSize\": %zu,\n", rawDataSize(clipboard.data.raw).value());
+                printf("        \"path\": \"%s\"\n", storedRawData(clipboard.data.raw).first.string().data());
                 printf("    }");
             } else {
-                printf("\"%s\"", JSONescape(content).data());
+                printf("\"%s\"", JSONescape(rawDataContents(clipboard.data.raw).value()).data());
             }
         } else {
             printf("[");
@@ -135,7 +133,7 @@ void statusJSON() {
             }
             printf("\n    ]");
         }
-        if (clipboard.name() != clipboards_with_contents.back().name()) printf(",\n");
+        if (clipboard.name() != clipboards_with_contents.back().name) printf(",\n");
     }
     printf("\n}\n");
 }
@@ -37,26 +37,17 @@ void swap() {
         );
 
     Clipboard destination(destination_name);
-
-    fs::path swapTargetSource(path.data);
-    swapTargetSource.replace_extension("swap");
-
-    fs::path swapTargetDestination(destination.data);
-    swapTargetDestination.replace_extension("swap");
+    destination.materializeEntry(destination.entry());
 
     try {
-        fs::copy(destination.data, swapTargetSource, fs::copy_options::recursive);
-        fs::copy(path.data, swapTargetDestination, fs::copy_options::recursive);
-
-        fs::remove_all(path.data);
-        fs::remove_all(destination.data);
-
-        fs::rename(swapTargetSource, path.data);
-        fs::rename(swapTargetDestination, destination.data);
+        swapPaths(path.data, destination.data);
+        path.journalSwapWith(destination);
     } catch (const fs::filesystem_error& e) {
         copying.failedItems.emplace_back(destination_name, e.code());
     }
 
+    destination.markContentChanged();
+
     stopIndicator();
 
     if (!output_silent && !confirmation_silent)
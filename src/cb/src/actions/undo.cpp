@@ -16,6 +16,21 @@
 #include "../clipboard.hpp"
 
 namespace PerformAction {
-void undo() {}
+
+void undo() {
+    bool stepped = false;
+    try {
+        stepped = path.undo();
+    } catch (const fs::filesystem_error& e) {
+        error_exit(formatColors("[error][inverse] ✘ [noinverse] CB couldn't undo the last change because %s. [help]⬤ Try copying something new instead.[blank]\n"), e.code().message());
+    }
+    if (!stepped) error_exit("%s", formatColors("[error][inverse] ✘ [noinverse] There's nothing to undo in this clipboard. [help]⬤ Try copying or changing something first.[blank]\n"));
+
+    stopIndicator();
+
+    if (!output_silent && !confirmation_silent) fprintf(stderr, formatColors("[success][inverse] ✔ [noinverse] Undid the last change in clipboard %s[blank]\n").data(), clipboard_name.data());
+
+    if (clipboard_name == constants.default_clipboard_name) updateExternalClipboards(true);
+}
 
 } // namespace PerformAction
\ No newline at end of file
@@ -15,7 +15,195 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "clipboard.hpp"
 #include <charconv>
+#include <fstream>
+#include <openssl/evp.h>
 #include <openssl/sha.h>
+#include <utility>
+
+#if defined(UNIX_OR_UNIX_LIKE)
+#include <sys/mman.h>
+#endif
+
+#if defined(__linux__)
+#include <spawn.h>
+extern char** environ;
+#endif
+
+namespace {
+
+// hands out entry numbers from a counter that every cb process maps and bumps atomically, so concurrent writers never pick the same one
+unsigned long allocatedEntry(const fs::path& counter, const unsigned long& atLeast) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    int fd = open(counter.string().data(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) return atLeast;
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (info.st_size >= static_cast<off_t>(sizeof(uint64_t)) || ftruncate(fd, sizeof(uint64_t)) == 0))
+        mapping = mmap(nullptr, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return atLeast;
+    std::atomic_ref<uint64_t> next(*static_cast<uint64_t*>(mapping));
+    // the counter starts out empty, and entries may have been imported since it was last used
+    for (auto current = next.load(); current < atLeast && !next.compare_exchange_weak(current, atLeast);) {}
+    auto entry = next.fetch_add(1);
+    munmap(mapping, sizeof(uint64_t));
+    return entry;
+#else
+    return atLeast;
+#endif
+}
+
+std::optional<unsigned long> entryNumber(const std::string_view& name) {
+    unsigned long entry;
+    if (auto [ptr, ec] = std::from_chars(name.data(), name.data() + name.size(), entry); ec != std::errc() || ptr != name.data() + name.size()) return std::nullopt;
+    return entry;
+}
+
+void forEachName(const fs::path& directory, const std::function<void(const std::string_view&)>& callback) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    auto dirptr = opendir(directory.string().data());
+    if (dirptr == nullptr) return;
+    for (auto* dir = readdir(dirptr); dir != nullptr; dir = readdir(dirptr))
+        callback(dir->d_name);
+    closedir(dirptr);
+#else
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(directory, ec))
+        callback(entry.path().filename().string());
+#endif
+}
+
+struct HistoryLimits {
+    unsigned long long bytes = 0;
+    unsigned long seconds = 0;
+    unsigned long entries = 0;
+};
+
+HistoryLimits historyLimits() {
+    HistoryLimits limits;
+    for (const auto& setting : regexSplit(maximumHistorySize, std::regex("\\s+"))) {
+        try {
+            std::string lastTwoChars(setting.end() - 2, setting.end());
+            std::transform(lastTwoChars.begin(), lastTwoChars.end(), lastTwoChars.begin(), ::tolower);
+            if (lastTwoChars == "tb")
+                limits.bytes = std::stold(setting) * 1024.0 * 1024.0 * 1024.0 * 1024.0;
+            else if (lastTwoChars == "gb")
+                limits.bytes = std::stold(setting) * 1024.0 * 1024.0 * 1024.0;
+            else if (lastTwoChars == "mb")
+                limits.bytes = std::stold(setting) * 1024.0 * 1024.0;
+            else if (lastTwoChars == "kb")
+                limits.bytes = std::stold(setting) * 1024.0;
+            else if (lastTwoChars.at(1) == 'b')
+                limits.bytes = std::stoull(setting);
+            else if (lastTwoChars.at(1) == 'y')
+                limits.seconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 365.0;
+            else if (lastTwoChars.at(1) == 'm')
+                limits.seconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 30.0;
+            else if (lastTwoChars.at(1) == 'w')
+                limits.seconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 7.0;
+            else if (lastTwoChars.at(1) == 'd')
+                limits.seconds = std::stold(setting) * 60.0 * 60.0 * 24.0;
+            else if (lastTwoChars.at(1) == 'h')
+                limits.seconds = std::stold(setting) * 60.0 * 60.0;
+            else if (lastTwoChars.at(1) == 's')
+                limits.seconds = std::stoul(setting);
+            else
+                limits.entries = std::stoul(setting);
+        } catch (...) {}
+    }
+    return limits;
+}
+
+enum class Eviction {
+    Oldest,
+    LeastRecentlyUsed,
+    LeastFrequentlyUsed
+};
+
+Eviction evictionPolicy() {
+    static auto policy = [] {
+        auto setting = getenv("CLIPBOARD_EVICTION");
+        if (!setting) return Eviction::Oldest;
+        std::string value(setting);
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+        if (value == "lru") return Eviction::LeastRecentlyUsed;
+        if (value == "lfu") return Eviction::LeastFrequentlyUsed;
+        return Eviction::Oldest;
+    }();
+    return policy;
+}
+
+// every copy into and paste out of a capped clipboard appends one of these to its access log, and readers add them up per entry
+struct AccessRecord {
+    uint64_t entry;
+    int64_t time;
+    uint64_t count;
+};
+static_assert(sizeof(AccessRecord) == 24);
+
+struct HotTierLimits {
+    unsigned long entries = 0;
+    unsigned long long bytes = 0;
+};
+
+// CLIPBOARD_HOT_TIER takes an entry count, a size like 64mb, or both
+std::optional<HotTierLimits> hotTierLimits() {
+    static auto limits = []() -> std::optional<HotTierLimits> {
+        auto setting = getenv("CLIPBOARD_HOT_TIER");
+        if (!setting) return std::nullopt;
+        HotTierLimits limits;
+        for (auto part : regexSplit(setting, std::regex("\\s+"))) {
+            std::transform(part.begin(), part.end(), part.begin(), ::tolower);
+            try {
+                if (part.ends_with("tb"))
+                    limits.bytes = std::stold(part) * 1024.0 * 1024.0 * 1024.0 * 1024.0;
+                else if (part.ends_with("gb"))
+                    limits.bytes = std::stold(part) * 1024.0 * 1024.0 * 1024.0;
+                else if (part.ends_with("mb"))
+                    limits.bytes = std::stold(part) * 1024.0 * 1024.0;
+                else if (part.ends_with("kb"))
+                    limits.bytes = std::stold(part) * 1024.0;
+                else if (part.ends_with("b"))
+                    limits.bytes = std::stoull(part);
+                else
+                    limits.entries = std::stoul(part);
+            } catch (...) {}
+        }
+        if (limits.entries == 0 && limits.bytes == 0) return std::nullopt;
+        return limits;
+    }();
+    return limits;
+}
+
+} // namespace
+
+std::vector<std::pair<unsigned long, fs::path>> movedItemsIn(const fs::path& list) {
+    std::vector<std::pair<unsigned long, fs::path>> items;
+    for (const auto& line : fileLines(list)) {
+        auto separator = line.find(' ');
+        if (separator == std::string::npos) continue;
+        if (auto entry = entryNumber(std::string_view(line).substr(0, separator))) items.emplace_back(entry.value(), line.substr(separator + 1));
+    }
+    return items;
+}
+
+void saveMovedItems(const fs::path& list, const std::vector<std::pair<unsigned long, fs::path>>& items) {
+    std::error_code ec;
+    if (items.empty()) {
+        fs::remove(list, ec);
+        return;
+    }
+    std::string content;
+    for (const auto& [entry, original] : items)
+        content += std::to_string(entry) + " " + original.string() + "\n";
+    writeToFile(list, content);
+}
+
+fs::path coldTierFor(const std::string& clipboard) {
+    // a temporary clipboard's older entries live under the persistent directory with the same name, where they survive a reboot
+    if (isPersistent(clipboard) || global_path.persistent == global_path.temporary) return {};
+    return global_path.persistent / clipboard;
+}
 
 Clipboard::Clipboard(const std::string& clipboard_name, const unsigned long& clipboard_entry) {
     this_name = clipboard_name;
@@ -25,10 +213,26 @@ Clipboard::Clipboard(const std::string& clipboard_name, const unsigned long& cli
 
     root = (is_persistent ? global_path.persistent : global_path.temporary) / this_name;
 
+    cold_root = coldTierFor(this_name);
+
+    metadata = root / constants.metadata_directory;
+    metadata.ignore = metadata / constants.ignore_regex_name;
+    metadata.ignore_secret = metadata / constants.ignore_secret_name;
+    metadata.in_progress = metadata / constants.in_progress_name;
+    metadata.lock = metadata / constants.lock_name;
+    metadata.moved = metadata / constants.moved_files_name;
+    metadata.notes = metadata / constants.notes_name;
+    metadata.originals = metadata / constants.original_files_name;
+    metadata.script = metadata / constants.script_name;
+    metadata.script_config = metadata / constants.script_config_name;
+    metadata.version = metadata / constants.storage_protocol_version_name;
+
+    if (!cachedStatus(metadata).is_directory) createDirectories(metadata);
+
     entryIndex = generatedEntryIndex();
 
     try {
-        data = root / constants.data_directory / std::to_string(entryIndex.at(this_entry));
+        data = entryDirectoryFor(entryNumberAt(this_entry));
     } catch (...) {
         clipboard_state = ClipboardState::Error;
         stopIndicator();
@@ -41,57 +245,140 @@ Clipboard::Clipboard(const std::string& clipboard_name, const unsigned long& cli
 
     data.raw = data / constants.data_file_name;
 
-    metadata = root / constants.metadata_directory;
-    metadata.ignore = metadata / constants.ignore_regex_name;
-    metadata.ignore_secret = metadata / constants.ignore_secret_name;
-    metadata.lock = metadata / constants.lock_name;
-    metadata.notes = metadata / constants.notes_name;
-    metadata.originals = metadata / constants.original_files_name;
-    metadata.script = metadata / constants.script_name;
-    metadata.script_config = metadata / constants.script_config_name;
-    metadata.version = metadata / constants.storage_protocol_version_name;
-
-    fs::create_directories(data);
-    fs::create_directories(metadata);
-
-    writeToFile(metadata.version, std::string(constants.storage_protocol_version));
+    // readers take a segmented entry straight from its segment, and only write actions move it out, once they hold the lock
+    if (!cachedStatus(data).is_directory && !segmentsHolding(entryIndex.at(this_entry)).find(entryIndex.at(this_entry))) createDirectories(data);
 }
 
 std::deque<unsigned long> Clipboard::generatedEntryIndex() {
     // auto then = std::chrono::system_clock::now();
     std::deque<unsigned long> pathNames;
     fs::path entriesDir = root / constants.data_directory;
-    fs::create_directories(entriesDir);
-#if defined(UNIX_OR_UNIX_LIKE)
-    auto dirptr = opendir(entriesDir.string().data());
-    errno = 0;
-    for (auto* dir = readdir(dirptr); dir != nullptr; dir = readdir(dirptr), errno = 0) {
-        pathNames.emplace_back(0);
-        if (auto [ptr, ec] = std::from_chars(dir->d_name, dir->d_name + strlen(dir->d_name), pathNames.back()); ec != std::errc()) [[unlikely]]
-            pathNames.pop_back();
+    createDirectories(entriesDir);
+    bool sharded = manifest().sharded;
+    misplaced_entries.clear();
+    unlisted_shards.clear();
+    held_back_entries.clear();
+    cold_entries.clear();
+    cold_tier_unlisted = !cold_root.empty();
+
+    std::vector<std::pair<unsigned long, fs::path>> shards;
+    std::vector<unsigned long> loose = segmentsFor(root).entries();
+    forEachName(entriesDir, [&](const std::string_view& name) {
+        if (auto entry = entryNumber(name)) {
+            loose.emplace_back(entry.value());
+            if (sharded) misplaced_entries.emplace(entry.value());
+        } else if (name.ends_with(constants.shard_extension)) {
+            if (auto shard = entryNumber(name.substr(0, name.size() - constants.shard_extension.size()))) shards.emplace_back(shard.value(), entriesDir / name);
+        }
+    });
+    std::sort(shards.begin(), shards.end(), std::greater<>());
+    std::sort(loose.begin(), loose.end(), std::greater<>());
+
+    // shards are listed newest first, and once there are enough entries to reach the chosen one, the rest wait until something needs the whole history
+    auto firstHeldBack = loose.end();
+    size_t listed = 0;
+    for (; listed < shards.size(); listed++) {
+        if (sharded && listed > 0) {
+            auto bound = shards.at(listed - 1).first * constants.entries_per_shard;
+            firstHeldBack = std::find_if(loose.begin(), loose.end(), [&](const auto& entry) { return entry < bound; });
+            if (pathNames.size() + (firstHeldBack - loose.begin()) > this_entry + 1) break;
+        }
+        forEachName(shards.at(listed).second, [&](const std::string_view& name) {
+            if (auto entry = entryNumber(name)) {
+                pathNames.emplace_back(entry.value());
+                if (!sharded) misplaced_entries.emplace(entry.value());
+            }
+        });
     }
-#else
-    for (const auto& entry : fs::directory_iterator(entriesDir))
-        try {
-            pathNames.emplace_back(std::stoul(entry.path().filename().string()));
-        } catch (...) {}
-#endif
+    if (listed == shards.size()) firstHeldBack = loose.end();
+    pathNames.insert(pathNames.end(), loose.begin(), firstHeldBack);
+    held_back_entries.assign(firstHeldBack, loose.end());
+    for (; listed < shards.size(); listed++)
+        unlisted_shards.emplace_back(shards.at(listed));
+
+    // everything in the cold tier is older than what's still in RAM, so it only needs listing once RAM runs out of entries
+    if (pathNames.size() <= this_entry) listColdEntries(pathNames);
+
     if (pathNames.empty()) pathNames.emplace_back(0);
     std::sort(pathNames.begin(), pathNames.end(), std::greater<>());
+    pathNames.erase(std::unique(pathNames.begin(), pathNames.end()), pathNames.end());
     // auto now = std::chrono::system_clock::now();
     // std::cout << "Took " << std::chrono::duration_cast<std::chrono::microseconds>(now - then).count() << "us to index " << pathNames.size() << " entries" << std::endl;
     return pathNames;
 }
 
-bool Clipboard::holdsRawDataInCurrentEntry() const {
+void Clipboard::indexAllEntries(bool includeColdTier) {
+    while (listNextShard(includeColdTier))
+        ;
+}
+
+bool Clipboard::listNextShard(bool includeColdTier) {
+    // everything listed here is older than what's already in the index, so only the new part needs sorting
+    auto listed = entryIndex.size();
+    while (entryIndex.size() == listed) {
+        if (!unlisted_shards.empty()) {
+            auto [number, shard] = unlisted_shards.front();
+            unlisted_shards.erase(unlisted_shards.begin());
+            forEachName(shard, [&](const std::string_view& name) {
+                if (auto entry = entryNumber(name)) entryIndex.emplace_back(entry.value());
+            });
+            auto bound = number * constants.entries_per_shard;
+            auto firstOlder = std::find_if(held_back_entries.begin(), held_back_entries.end(), [&](const auto& entry) { return entry < bound; });
+            entryIndex.insert(entryIndex.end(), held_back_entries.begin(), firstOlder);
+            held_back_entries.erase(held_back_entries.begin(), firstOlder);
+        } else if (!held_back_entries.empty() || (includeColdTier && cold_tier_unlisted)) {
+            entryIndex.insert(entryIndex.end(), held_back_entries.begin(), held_back_entries.end());
+            held_back_entries.clear();
+            if (includeColdTier) listColdEntries(entryIndex);
+            if (entryIndex.size() == listed) return false;
+        } else
+            return false;
+    }
+    std::sort(entryIndex.begin() + listed, entryIndex.end(), std::greater<>());
+    entryIndex.erase(std::unique(entryIndex.begin() + listed, entryIndex.end()), entryIndex.end());
+    return true;
+}
+
+void Clipboard::listColdEntries(std::deque<unsigned long>& entries) {
+    if (!cold_tier_unlisted) return;
+    cold_tier_unlisted = false;
     std::error_code ec;
-    bool empty = fs::is_empty(data.raw, ec);
-    if (ec) return false; // errors out if the file doesn't exist, return false to save on a syscall
-    return !empty;
+    if (!fs::exists(cold_root, ec)) return;
+    // an entry caught halfway through demotion still counts as being in RAM until its copy there is gone
+    std::unordered_set<unsigned long> hot(entries.begin(), entries.end());
+    auto add = [&](const unsigned long& entry) {
+        if (hot.contains(entry) || !cold_entries.emplace(entry).second) return;
+        entries.emplace_back(entry);
+    };
+    for (const auto& entry : segmentsFor(cold_root).entries())
+        add(entry);
+    auto coldData = cold_root / constants.data_directory;
+    forEachName(coldData, [&](const std::string_view& name) {
+        if (!name.ends_with(constants.shard_extension)) return;
+        forEachName(coldData / name, [&](const std::string_view& name) {
+            if (auto entry = entryNumber(name)) add(entry.value());
+        });
+    });
+}
+
+const unsigned long& Clipboard::entryNumberAt(const unsigned long& entry) {
+    if (entry >= entryIndex.size()) indexAllEntries();
+    return entryIndex.at(entry);
+}
+
+bool Clipboard::holdsRawDataInCurrentEntry() const {
+    if (auto status = cachedStatus(data.raw); status.exists) return status.size > 0;
+    // only when the file doesn't exist is it worth looking for a compressed copy
+    auto [file, codec] = storedRawData(data.raw);
+    if (codec != Codec::None) return cachedStatus(file).size > 0;
+    return segmentedRawData(data.raw).has_value();
 }
 
 bool Clipboard::holdsDataInCurrentEntry() {
-    if (fs::is_empty(data)) return false;
+    std::error_code ec;
+    bool empty = fs::is_empty(data, ec);
+    if (ec) return holdsRawDataInCurrentEntry(); // there's no directory when the entry lives in a segment
+    if (empty) return false;
     if (holdsRawDataInCurrentEntry()) return true;
     for (const auto& entry : fs::directory_iterator(data))
         if (!fs::is_empty(entry)) return true;
@@ -99,64 +386,171 @@ bool Clipboard::holdsDataInCurrentEntry() {
 }
 
 bool Clipboard::holdsIgnoreRegexes() {
-    return fs::exists(metadata.ignore) && !fs::is_empty(metadata.ignore);
+    return manifest().ignore && !manifest().ignore->empty();
 }
 
 bool Clipboard::holdsIgnoreSecrets() {
-    return fs::exists(metadata.ignore_secret) && !fs::is_empty(metadata.ignore_secret);
+    return manifest().ignore_secret && !manifest().ignore_secret->empty();
 }
 
-std::vector<std::regex> Clipboard::ignoreRegexes() {
-    std::vector<std::regex> regexes;
-    if (!holdsIgnoreRegexes()) return regexes;
-    for (const auto& line : fileLines(metadata.ignore))
-        regexes.emplace_back(line);
-    return regexes;
+bool Clipboard::holdsScript() {
+    // looked up every time rather than kept in the manifest, so removing the script by hand is enough to stop it
+    return cachedStatus(metadata.script).is_regular_file;
 }
 
-std::vector<std::string> Clipboard::ignoreSecrets() {
-    std::vector<std::string> secrets;
-    if (!holdsIgnoreSecrets()) return secrets;
-    for (const auto& line : fileLines(metadata.ignore_secret))
-        secrets.emplace_back(line);
-    return secrets;
+Manifest& Clipboard::manifest() {
+    if (this_manifest) return *this_manifest;
+    auto file = metadata / constants.manifest_name;
+    if (auto loaded = Manifest::load(file)) {
+        this_manifest = std::make_shared<Manifest>(std::move(loaded.value()));
+        return *this_manifest;
+    }
+
+    this_manifest = std::make_shared<Manifest>();
+    std::array legacy {metadata.notes, metadata.ignore, metadata.ignore_secret, metadata.script_config, metadata.version};
+    if (std::none_of(legacy.begin(), legacy.end(), [](const auto& file) { return cachedStatus(file).exists; })) {
+        saveManifest();
+        return *this_manifest;
+    }
+
+    // clipboards from before the manifest kept each of these in its own file, so move them over once under the lock and then they're gone
+    bool tookLock = !holds_lock;
+    getLock();
+    if (auto loaded = Manifest::load(file))
+        *this_manifest = std::move(loaded.value()); // someone else migrated it while we waited
+    else {
+        this_manifest->notes = fileContents(metadata.notes);
+        this_manifest->ignore = fileContents(metadata.ignore);
+        this_manifest->ignore_secret = fileContents(metadata.ignore_secret);
+        this_manifest->script_config = fileContents(metadata.script_config);
+        this_manifest->save(file);
+    }
+    std::error_code ec;
+    for (const auto& old : legacy)
+        removeRecursively(old, ec);
+    if (tookLock) releaseLock();
+    return *this_manifest;
 }
 
-void Clipboard::applyIgnoreRules() {
-    if (holdsIgnoreRegexes()) {
-        auto regexes = ignoreRegexes();
-        if (holdsRawDataInCurrentEntry()) {
-            auto content = fileContents(data.raw).value();
-            for (const auto& regex : regexes)
-                content = std::regex_replace(content, regex, "");
-            writeToFile(data.raw, content);
+void Clipboard::saveManifest() {
+    // a reader loaded its copy without the lock, so saving it could undo whatever a writer saved since
+    if (!holds_lock && isAReadOnlyAction()) return;
+    auto file = metadata / constants.manifest_name;
+    manifest().save(file);
+}
+
+void Clipboard::markContentChanged(bool anyEntry) {
+    // a brand new entry just adds to the totals, while anything else could have changed sizes anywhere
+    if (auto& totals = manifest().totals) {
+        if (std::exchange(fresh_entry, false) && totals->entries + 1 == totalEntries()) {
+            totals->entries++;
+            totals->bytes += totalDirectorySize(data);
         } else
-            for (const auto& regex : regexes)
-                for (const auto& entry : fs::directory_iterator(data))
-                    if (std::regex_match(entry.path().filename().string(), regex)) fs::remove_all(entry.path());
-    }
-
-    if (holdsIgnoreSecrets()) {
-        auto secrets = ignoreSecrets();
-        if (!holdsRawDataInCurrentEntry()) return;
-        auto content = fileContents(data.raw).value();
-        std::array<unsigned char, SHA512_DIGEST_LENGTH> hash;
-        for (const auto& secret : secrets) {
-            SHA512(reinterpret_cast<const unsigned char*>(content.data()), content.size(), hash.data());
-            std::stringstream ss;
-            for (const auto& byte : hash)
-                ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
-            if (ss.str() == secret) {
-                writeToFile(data.raw, "");
-                break;
-            }
+            totals.reset();
+        saveManifest();
+    }
+    updateCatalog(*this, anyEntry);
+}
+
+IgnoreRules::IgnoreRules(const std::vector<std::string>& patterns, const std::vector<std::string>& hexSecrets) {
+    for (const auto& pattern : patterns)
+        regexes.emplace_back(pattern);
+    // a backreference counts groups across the whole regex, so it'd point into some other pattern once they're combined
+    auto hasBackreference = [](const std::string& pattern) {
+        for (size_t i = 0; i + 1 < pattern.size(); i++) {
+            if (pattern.at(i) != '\\') continue;
+            if (pattern.at(i + 1) >= '1' && pattern.at(i + 1) <= '9') return true;
+            i++; // whatever's escaped can't start an escape of its own
         }
+        return false;
+    };
+    if (patterns.size() > 1 && std::none_of(patterns.begin(), patterns.end(), hasBackreference)) {
+        // one alternation lets regex_match make a single pass no matter how many patterns there are
+        std::string alternation;
+        for (const auto& pattern : patterns)
+            alternation += (alternation.empty() ? "(?:" : "|(?:") + pattern + ")";
+        combined.emplace(alternation);
     }
+    for (const auto& hex : hexSecrets) {
+        if (hex.size() != SHA512_DIGEST_LENGTH * 2) continue;
+        std::string digest(SHA512_DIGEST_LENGTH, '\0');
+        bool valid = true;
+        for (size_t i = 0; i < digest.size() && valid; i++)
+            valid = std::from_chars(hex.data() + i * 2, hex.data() + i * 2 + 2, reinterpret_cast<unsigned char&>(digest[i]), 16).ec == std::errc();
+        if (valid) secrets.emplace(std::move(digest));
+    }
+}
+
+bool IgnoreRules::ignores(const std::string& item) const {
+    if (combined) return std::regex_match(item, combined.value());
+    return std::any_of(regexes.begin(), regexes.end(), [&](const auto& regex) { return std::regex_match(item, regex); });
+}
+
+std::string IgnoreRules::filtered(const std::string& content) const {
+    // one pattern at a time, since removing what one matches can leave something another one matches
+    auto result = content;
+    for (const auto& regex : regexes)
+        result = std::regex_replace(result, regex, "");
+    return result;
+}
+
+bool IgnoreRules::isSecret(const std::string_view& content) const {
+    if (secrets.empty()) return false;
+    std::string digest(SHA512_DIGEST_LENGTH, '\0');
+    SHA512(reinterpret_cast<const unsigned char*>(content.data()), content.size(), reinterpret_cast<unsigned char*>(digest.data()));
+    return secrets.contains(digest);
+}
+
+bool IgnoreRules::isSecretData(const fs::path& raw) const {
+    if (secrets.empty()) return false;
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> context(EVP_MD_CTX_new(), &EVP_MD_CTX_free);
+    EVP_DigestInit_ex(context.get(), EVP_sha512(), nullptr);
+    bool found = streamRawData(raw, [&](const std::string_view& chunk) {
+        EVP_DigestUpdate(context.get(), chunk.data(), chunk.size());
+        return true;
+    });
+    if (!found) return false;
+    std::string digest(SHA512_DIGEST_LENGTH, '\0');
+    EVP_DigestFinal_ex(context.get(), reinterpret_cast<unsigned char*>(digest.data()), nullptr);
+    return secrets.contains(digest);
+}
+
+const IgnoreRules& Clipboard::ignoreRules() {
+    if (!ignore_rules)
+        ignore_rules = std::make_shared<const IgnoreRules>(contentLines(manifest().ignore.value_or("")), contentLines(manifest().ignore_secret.value_or("")));
+    return *ignore_rules;
+}
+
+void Clipboard::applyIgnoreRules() {
+    const auto& rules = ignoreRules();
+    if (rules.empty()) return;
+
+    if (holdsRawDataInCurrentEntry()) {
+        if (!rules.hasRegexes()) {
+            // nothing to rewrite, so hash the stored data as it streams by instead of loading all of it
+            if (rules.isSecretData(data.raw)) writeRawData(data.raw, "");
+            return;
+        }
+        auto content = rawDataContents(data.raw).value();
+        auto filtered = rules.filtered(content);
+        if (rules.isSecret(filtered))
+            writeRawData(data.raw, "");
+        else if (filtered.size() != content.size())
+            writeRawData(data.raw, filtered);
+        return;
+    }
+
+    if (!rules.hasRegexes()) return;
+    std::vector<fs::path> ignored;
+    for (const auto& entry : fs::directory_iterator(data))
+        if (rules.ignores(entry.path().filename().string())) ignored.emplace_back(entry.path());
+    for (const auto& entry : ignored)
+        removeRecursively(entry);
 }
 
 bool Clipboard::isUnused() {
     if (holdsDataInCurrentEntry()) return false;
-    if (fs::exists(metadata.notes) && !fs::is_empty(metadata.notes)) return false;
+    if (manifest().notes && !manifest().notes->empty()) return false;
     if (fs::exists(metadata.originals) && !fs::is_empty(metadata.originals)) return false;
     return true;
 }
@@ -180,26 +574,198 @@ void Clipboard::getLock() {
         }
     }
     writeToFile(metadata.lock, std::to_string(thisPID()));
+    holds_lock = true;
+
+    // a writer killed partway leaves its staging directory behind, and now that we hold the lock, nobody else can still be filling one
+    std::vector<fs::path> stale;
+    for (const auto& entries : {root / constants.data_directory, cold_root.empty() ? fs::path() : cold_root / constants.data_directory})
+        forEachName(entries, [&](const std::string_view& name) {
+            if (name.starts_with('.') && name.ends_with(constants.staging_extension)) stale.emplace_back(entries / name);
+        });
+    std::error_code ec;
+    for (const auto& staging : stale)
+        removeRecursively(staging, ec);
+}
+
+void Clipboard::releaseLock() {
+    if (!holds_lock) return;
+    std::error_code ec;
+    fs::remove(metadata.lock, ec);
+    holds_lock = false;
 }
 
 void Clipboard::makeNewEntry() {
-    entryIndex.emplace_front(entryIndex.front() + 1);
+    publishEntry();
+
+    // the new entry fills up under a hidden name that the entry index skips, so readers only ever see it once it's complete, or once it's marked as still filling up
+    auto counter = metadata / constants.entry_counter_name;
+    for (auto entry = allocatedEntry(counter, entryIndex.front() + 1);; entry = allocatedEntry(counter, entry + 1)) {
+        // without a shared counter, claiming the staging directory is what keeps two writers apart
+        auto staging = root / constants.data_directory / ("." + std::to_string(entry) + std::string(constants.staging_extension));
+        if (fs::exists(entryDirectoryFor(entry)) || !fs::create_directory(staging)) continue;
+        entryIndex.emplace_front(entry);
+        staged_entry = entry;
+        fresh_entry = true;
+        data = staging;
+        data.raw = data / constants.data_file_name;
+        return;
+    }
+}
+
+void Clipboard::stageEntryChange() {
+    if (staged_entry || changed_entry) return;
+    auto entry = entryNumberAt(this_entry);
+    materializeEntry(this_entry);
+    // the change goes into a copy made of hard links, so it costs no more than the entry's metadata, and replaces the entry in one step once it's done
+    auto staging = (cold_entries.contains(entry) ? cold_root : root) / constants.data_directory / ("." + std::to_string(entry) + std::string(constants.staging_extension));
+    std::error_code ec;
+    removeRecursively(staging, ec);
+    cowCopy(data, staging, false);
+    // adding and editing write into the raw data itself rather than replacing it, which would reach through the link to what readers still see
+    if (action_is_one_of(Action::Add, Action::Edit))
+        if (auto file = storedRawData(data.raw).first; fs::exists(file)) {
+            fs::remove(staging / file.filename());
+            cowCopyFile(file, staging / file.filename());
+        }
+    changed_entry = entry;
+    data = staging;
+    data.raw = data / constants.data_file_name;
+}
+
+void Clipboard::publishEntry() {
+    if (changed_entry) {
+        auto live = entryDirectoryFor(changed_entry.value());
+        fs::path staging = data, previous = data;
+        if (!exchangePaths(staging, live)) {
+            // without an atomic exchange there's a moment with no entry at all, which readers treat like an empty one
+            previous = fs::path(data).replace_filename("." + std::to_string(changed_entry.value()) + "-previous" + std::string(constants.staging_extension));
+            renamePath(live, previous);
+            renamePath(staging, live);
+        }
+        moveWrittenFiles(staging, live);
+        data = live;
+        data.raw = data / constants.data_file_name;
+        keepForUndo(std::exchange(changed_entry, std::nullopt).value(), previous);
+        return;
+    }
+    if (!staged_entry) return;
+    auto published = entryDirectoryFor(staged_entry.value());
+    createDirectories(published.parent_path());
+    renamePath(data, published);
+    moveWrittenFiles(data, published);
+    data = published;
+    data.raw = data / constants.data_file_name;
+    if (!maximumHistorySize.empty() && evictionPolicy() == Eviction::LeastRecentlyUsed) appendAccessRecord(staged_entry.value(), 0); // being written counts as a use
+    staged_entry.reset();
+}
+
+void Clipboard::publishEntryInProgress() {
+    if (!staged_entry) return;
+    // the marker goes up before the entry does, so nobody ever sees the entry without knowing there's more coming
+    writeToFile(data.raw, "");
+    writeToFile(metadata.in_progress, std::to_string(staged_entry.value()) + " " + std::to_string(thisPID()));
+    publishEntry();
+}
+
+void Clipboard::finishEntryInProgress() {
+    std::error_code ec;
+    fs::remove(metadata.in_progress, ec);
+    // followers wake up on changes to the data itself, so touch it once more to let them know it's done
+    fs::last_write_time(data.raw, fs::file_time_type::clock::now(), ec);
+}
+
+void Clipboard::abandonEntryInProgress() {
+    // nobody gets to keep reading an entry that will never be complete, so it goes away along with its marker
+    auto entry = staged_entry.value_or(entryNumberAt(this_entry));
+    std::error_code ec;
+    fs::remove(metadata.in_progress, ec);
+    removeRecursively(data, ec);
+    staged_entry.reset();
+    std::erase(entryIndex, entry);
+    if (entryIndex.empty()) entryIndex.emplace_back(0);
+}
+
+bool Clipboard::entryInProgress() {
+    auto marker = fileContents(metadata.in_progress);
+    if (!marker) return false;
+    unsigned long entry = 0;
+    long pid = 0;
+    std::istringstream(marker.value()) >> entry >> pid;
+    if (this_entry >= entryIndex.size() || entry != entryNumberAt(this_entry)) return false;
+    // a writer that died partway never gets to take its marker down
+#if defined(UNIX_OR_UNIX_LIKE)
+    return kill(pid, 0) == 0 || errno == EPERM;
+#elif defined(_WIN32) || defined(_WIN64)
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!process) return false;
+    bool running = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return running;
+#else
+    return true;
+#endif
+}
 
-    data = root / constants.data_directory / std::to_string(entryIndex.at(this_entry));
+void Clipboard::discardStagedEntry() {
+    if (!staged_entry && !changed_entry) return;
+    std::error_code ec;
+    removeRecursively(data, ec);
+    if (changed_entry) data = entryDirectoryFor(changed_entry.value());
     data.raw = data / constants.data_file_name;
+    staged_entry.reset();
+    changed_entry.reset();
+}
+
+fs::path Clipboard::entryDirectoryFor(const unsigned long& entry) {
+    if (cold_entries.contains(entry)) return coldEntryDirectoryFor(entry);
+    auto entries = root / constants.data_directory;
+    if (manifest().sharded == misplaced_entries.contains(entry)) return entries / std::to_string(entry);
+    return entries / (std::to_string(entry / constants.entries_per_shard) + std::string(constants.shard_extension)) / std::to_string(entry);
+}
 
-    fs::create_directories(data);
+fs::path Clipboard::coldEntryDirectoryFor(const unsigned long& entry) const {
+    // the cold tier has no older layout to stay compatible with, so it's always sharded
+    return cold_root / constants.data_directory / (std::to_string(entry / constants.entries_per_shard) + std::string(constants.shard_extension)) / std::to_string(entry);
+}
+
+SegmentStore& Clipboard::segmentsHolding(const unsigned long& entry) {
+    return segmentsFor(cold_entries.contains(entry) ? cold_root : root);
+}
+
+void Clipboard::shardEntries() {
+    if (!envVarIsTrue("CLIPBOARD_SHARDED") || (manifest().sharded && misplaced_entries.empty())) return;
+    auto entries = root / constants.data_directory;
+    if (!manifest().sharded) {
+        // everything outside a shard is about to become misplaced, so flip the layout first and then move entries over one by one
+        std::unordered_set<unsigned long> flat;
+        forEachName(entries, [&](const std::string_view& name) {
+            if (auto entry = entryNumber(name)) flat.emplace(entry.value());
+        });
+        manifest().sharded = true;
+        saveManifest();
+        misplaced_entries = std::move(flat);
+    }
+    while (!misplaced_entries.empty()) {
+        auto entry = *misplaced_entries.begin();
+        auto from = entries / std::to_string(entry);
+        misplaced_entries.erase(entry);
+        auto to = entryDirectoryFor(entry);
+        createDirectories(to.parent_path());
+        renamePath(from, to);
+    }
+    setEntry(this_entry);
 }
 
 void Clipboard::setEntry(const unsigned long& entry) {
     this_entry = entry;
-    data = root / constants.data_directory / std::to_string(entryIndex.at(this_entry));
+    data = entryDirectoryFor(entryNumberAt(this_entry));
     data.raw = data / constants.data_file_name;
 }
 
 fs::path Clipboard::entryPathFor(const unsigned long& entry) {
     try {
-        return root / constants.data_directory / std::to_string(entryIndex.at(entry));
+        if (staged_entry == entryNumberAt(entry) || changed_entry == entryNumberAt(entry)) return data;
+        return entryDirectoryFor(entryNumberAt(entry));
     } catch (...) {
         clipboard_state = ClipboardState::Error;
         stopIndicator();
@@ -212,85 +778,360 @@ fs::path Clipboard::entryPathFor(const unsigned long& entry) {
 }
 
 bool Clipboard::holdsData() {
-    for (const auto& entry : entryIndex)
-        if (!fs::is_empty(entryPathFor(entry))) return true;
-    return false;
+    for (unsigned long entry = 0;; entry++) {
+        if (entry == entryIndex.size()) indexAllEntries();
+        if (entry == entryIndex.size()) return false;
+        if (segmentedEntry(entry)) return true;
+        std::error_code ec;
+        if (!fs::is_empty(entryPathFor(entry), ec) && !ec) return true;
+    }
 }
 
-void Clipboard::trimHistoryEntries() {
-    if (maximumHistorySize.empty()) return;
-    auto settings = regexSplit(maximumHistorySize, std::regex("\\s+"));
-    unsigned long long maximumBytes = 0;
-    unsigned long maximumSeconds = 0;
-    unsigned long maximumEntries = 0;
-    for (const auto& setting : settings) {
-        try {
-            std::string lastTwoChars(setting.end() - 2, setting.end());
-            std::transform(lastTwoChars.begin(), lastTwoChars.end(), lastTwoChars.begin(), ::tolower);
-            if (lastTwoChars == "tb")
-                maximumBytes = std::stold(setting) * 1024.0 * 1024.0 * 1024.0 * 1024.0;
-            else if (lastTwoChars == "gb")
-                maximumBytes = std::stold(setting) * 1024.0 * 1024.0 * 1024.0;
-            else if (lastTwoChars == "mb")
-                maximumBytes = std::stold(setting) * 1024.0 * 1024.0;
-            else if (lastTwoChars == "kb")
-                maximumBytes = std::stold(setting) * 1024.0;
-            else if (lastTwoChars.at(1) == 'b')
-                maximumBytes = std::stoull(setting);
-            else if (lastTwoChars.at(1) == 'y')
-                maximumSeconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 365.0;
-            else if (lastTwoChars.at(1) == 'm')
-                maximumSeconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 30.0;
-            else if (lastTwoChars.at(1) == 'w')
-                maximumSeconds = std::stold(setting) * 60.0 * 60.0 * 24.0 * 7.0;
-            else if (lastTwoChars.at(1) == 'd')
-                maximumSeconds = std::stold(setting) * 60.0 * 60.0 * 24.0;
-            else if (lastTwoChars.at(1) == 'h')
-                maximumSeconds = std::stold(setting) * 60.0 * 60.0;
-            else if (lastTwoChars.at(1) == 's')
-                maximumSeconds = std::stoul(setting);
-            else
-                maximumEntries = std::stoul(setting);
-        } catch (...) {}
-    }
+std::optional<SegmentStore::Location> Clipboard::segmentedEntry(const unsigned long& entry) {
+    return segmentsHolding(entryNumberAt(entry)).find(entryNumberAt(entry));
+}
 
-    // std::cout << "maximumBytes = " << maximumBytes << std::endl;
-    // std::cout << "maximumSeconds = " << maximumSeconds << std::endl;
-    // std::cout << "maximumEntries = " << maximumEntries << std::endl;
+fs::file_time_type Clipboard::entryWriteTime(const unsigned long& entry) {
+    if (auto segment = segmentedEntry(entry)) return segment->writeTime();
+    return cachedStatus(entryPathFor(entry)).write_time;
+}
 
-    if (maximumBytes > 0) {
-        size_t startingClipboardSize = totalDirectorySize(root);
+void Clipboard::materializeEntry(const unsigned long& entry) {
+    segmentsHolding(entryNumberAt(entry)).materialize(entryNumberAt(entry), entryPathFor(entry));
+}
+
+void Clipboard::sealEntry(const unsigned long& entry) {
+    // move a small text entry into a segment so it stops costing a directory and a file of its own
+    if (segmentThreshold() == 0 || entry >= entryIndex.size()) return;
+    auto entryDirectory = entryPathFor(entry);
+    auto raw = entryDirectory / constants.data_file_name;
+    std::error_code ec;
+    auto size = fs::file_size(raw, ec);
+    if (ec || size == 0 || size > segmentThreshold()) return;
+    if (std::distance(fs::directory_iterator(entryDirectory), fs::directory_iterator {}) != 1) return;
+    auto content = fileContents(raw);
+    if (!content) return;
+    // the cached totals follow along by what the entry's directory cost and how much the segments grew
+    auto segments = (cold_entries.contains(entryNumberAt(entry)) ? cold_root : root) / constants.segments_directory;
+    unsigned long long before = 0;
+    if (manifest().totals) before = totalDirectorySize(entryDirectory) + (fs::exists(segments) ? totalDirectorySize(segments) : 0);
+    segmentsHolding(entryNumberAt(entry)).append(entryNumberAt(entry), content.value(), fs::last_write_time(raw));
+    removeRecursively(entryDirectory);
+    if (auto& totals = manifest().totals) {
+        totals->bytes = totals->bytes - std::min<unsigned long long>(totals->bytes, before) + totalDirectorySize(segments);
+        saveManifest();
+    }
+}
 
-        while (startingClipboardSize > maximumBytes) {
-            auto oldestPath = entryPathFor(entryIndex.size() - 1);
-            size_t oldestEntrySize = totalDirectorySize(oldestPath);
-            fs::remove_all(oldestPath);
-            entryIndex.pop_back();
-            startingClipboardSize -= oldestEntrySize;
+void Clipboard::trimHistoryEntries() {
+    if (isAWriteAction() && entryIndex.size() > 1) sealEntry(1); // the entry that was current before this write won't change anymore
+    if (maximumHistorySize.empty() || !holds_lock) return; // readers never remove anything
+    indexAllEntries(); // trimming works from the oldest entry
+    auto limits = historyLimits();
+    auto entriesBefore = entryIndex.size();
+
+    if (limits.bytes > 0) {
+        auto bytes = storedBytes();
+        for (const auto& entry : evictionOrder()) {
+            if (bytes <= limits.bytes) break;
+            bytes -= std::min(bytes, entrySize(entry));
+            evictEntry(entry);
         }
     }
 
-    if (maximumSeconds > 0) {
+    if (limits.seconds > 0) {
         auto now = std::chrono::system_clock::now();
 #if defined(UNIX_OR_UNIX_LIKE)
-        struct stat info;
-        auto lastModified = [&](const fs::path path) {
-            if (stat(path.string().data(), &info) != 0) return now;
-            return std::chrono::system_clock::from_time_t(info.st_mtime);
+        auto lastModified = [&](const unsigned long& entry) {
+            if (auto segment = segmentedEntry(entry)) return std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(segment->writeTime()));
+            auto status = cachedStatus(entryPathFor(entry));
+            if (!status.exists) return now;
+            return std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(status.write_time));
         };
 
-        while (lastModified(entryPathFor(entryIndex.size() - 1)) < now - std::chrono::seconds(maximumSeconds)) {
-            fs::remove_all(entryPathFor(entryIndex.size() - 1));
-            entryIndex.pop_back();
+        // age always goes by the oldest entry, no matter which eviction policy is set
+        auto pinned = entriesHoldingMovedItems();
+        for (auto entry = entryIndex.size(); entry-- > 0;) {
+            if (pinned.contains(entryIndex.at(entry))) continue;
+            if (lastModified(entry) >= now - std::chrono::seconds(limits.seconds)) break;
+            evictEntry(entryIndex.at(entry));
         }
 #endif
     }
 
-    if (maximumEntries > 0) {
-        if (entryIndex.size() <= maximumEntries || maximumEntries == 0) return;
-        while (entryIndex.size() > maximumEntries) {
-            fs::remove_all(entryPathFor(entryIndex.size() - 1));
-            entryIndex.pop_back();
+    if (limits.entries > 0 && entryIndex.size() > limits.entries) {
+        auto order = evictionOrder();
+        for (size_t entry = 0; entry < order.size() && entryIndex.size() > limits.entries; entry++)
+            evictEntry(order.at(entry));
+    }
+
+    if (manifest().totals) saveManifest();
+    if (entryIndex.size() < entriesBefore) updateCatalog(*this);
+
+    // trimming only leaves tombstones in segments, so reclaim their space once enough of it is wasted
+    segmentsFor(root).compact();
+    if (!cold_root.empty() && fs::exists(cold_root)) segmentsFor(cold_root).compact();
+}
+
+void Clipboard::makeRoomFor(const unsigned long long& incomingBytes) {
+    // a capped clipboard sheds old entries before a copy starts rather than going over its budget and scanning everything afterwards
+    if (maximumHistorySize.empty() || incomingBytes == 0 || !isAWriteAction()) return;
+    auto limits = historyLimits();
+    if (limits.bytes == 0) return;
+    indexAllEntries();
+    auto bytes = storedBytes();
+    if (bytes + incomingBytes <= limits.bytes) return;
+    for (const auto& entry : evictionOrder()) {
+        if (bytes + incomingBytes <= limits.bytes) break;
+        bytes -= std::min(bytes, entrySize(entry));
+        evictEntry(entry);
+    }
+    if (manifest().totals) saveManifest();
+}
+
+unsigned long long Clipboard::storedBytes() {
+    // the staged entry doesn't count yet, since markContentChanged adds it once it's written
+    auto published = totalEntries() - (staged_entry ? 1 : 0);
+    if (manifest().totals && manifest().totals->entries == published) return manifest().totals->bytes;
+    unsigned long long bytes = totalSize();
+    if (staged_entry) bytes -= std::min<unsigned long long>(bytes, totalDirectorySize(data));
+    manifest().totals = Manifest::Totals {published, bytes};
+    saveManifest();
+    return bytes;
+}
+
+void Clipboard::appendAccessRecord(const unsigned long& entry, const uint64_t& count) {
+    AccessRecord record {entry, std::chrono::system_clock::now().time_since_epoch().count(), count};
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen((metadata / constants.access_log_name).string().data(), "ab"), &std::fclose);
+    if (file) std::fwrite(&record, sizeof(AccessRecord), 1, file.get());
+    if (access_stats) {
+        auto& stats = (*access_stats)[entry];
+        stats.last = std::max(stats.last, record.time);
+        stats.count += count;
+    }
+}
+
+void Clipboard::recordAccess() {
+    // only capped clipboards evict by use, so the others don't pay for keeping track of it
+    if (maximumHistorySize.empty() || evictionPolicy() == Eviction::Oldest) return;
+    appendAccessRecord(entryNumberAt(this_entry), 1);
+}
+
+const std::map<unsigned long, Clipboard::EntryAccess>& Clipboard::accessStats() {
+    if (access_stats) return *access_stats;
+    access_stats.emplace();
+    auto contents = fileContents(metadata / constants.access_log_name);
+    if (!contents) return *access_stats;
+    size_t records = 0;
+    for (size_t offset = 0; offset + sizeof(AccessRecord) <= contents->size(); offset += sizeof(AccessRecord), records++) {
+        AccessRecord record;
+        std::memcpy(&record, contents->data() + offset, sizeof(AccessRecord));
+        auto& stats = (*access_stats)[record.entry];
+        stats.last = std::max(stats.last, record.time);
+        stats.count += record.count;
+    }
+
+    // every access adds a record, so fold them into one per entry once they far outnumber the entries, but only under the lock
+    if (!holds_lock || records < 2 * access_stats->size() + 64) return *access_stats;
+    std::string folded;
+    for (const auto& [entry, stats] : *access_stats) {
+        AccessRecord record {entry, stats.last, stats.count};
+        folded.append(reinterpret_cast<const char*>(&record), sizeof(AccessRecord));
+    }
+    writeToFile(metadata / constants.access_log_name, folded);
+    return *access_stats;
+}
+
+std::unordered_set<unsigned long> Clipboard::entriesHoldingMovedItems() {
+    std::unordered_set<unsigned long> entries;
+    for (const auto& [entry, original] : movedItemsIn(metadata.moved))
+        entries.emplace(entry);
+    return entries;
+}
+
+void Clipboard::returnMovedItems(const std::optional<unsigned long>& entry) {
+    // an item a cut moved in has no other copy, so before its entry goes away it goes back where it was cut from, and nothing moves unless everything can
+    std::vector<std::pair<fs::path, fs::path>> returning;
+    std::vector<std::pair<unsigned long, fs::path>> kept;
+    std::error_code ec;
+    for (const auto& item : movedItemsIn(metadata.moved)) {
+        if (entry && item.first != entry) {
+            kept.emplace_back(item);
+            continue;
+        }
+        auto inEntry = entryDirectoryFor(item.first) / item.second.filename();
+        if (!fs::exists(fs::symlink_status(inEntry, ec))) continue; // pasted already
+        if (fs::exists(fs::symlink_status(item.second, ec)))
+            throw fs::filesystem_error("Something else is where a cut item came from", item.second, std::make_error_code(std::errc::file_exists));
+        returning.emplace_back(inEntry, item.second);
+    }
+    for (const auto& [from, to] : returning) {
+        createDirectories(to.parent_path(), ec);
+        renamePath(from, to);
+    }
+    saveMovedItems(metadata.moved, kept);
+}
+
+std::vector<unsigned long> Clipboard::evictionOrder() {
+    // the current entry, the one being written and ones holding the only copy of something a cut moved in are never candidates
+    std::vector<unsigned long> candidates;
+    auto current = entryNumberAt(this_entry);
+    auto pinned = entriesHoldingMovedItems();
+    for (unsigned long entry = 1; entry < entryIndex.size(); entry++)
+        if (auto number = entryIndex.at(entry); number != current && staged_entry != number && !pinned.contains(number)) candidates.emplace_back(number);
+    std::reverse(candidates.begin(), candidates.end()); // oldest first
+
+    auto policy = evictionPolicy();
+    if (policy == Eviction::Oldest) return candidates;
+    // entries with no recorded use sort by age ahead of everything else, and stable sorting keeps ties oldest first
+    const auto& stats = accessStats();
+    auto usage = [&](const unsigned long& entry) {
+        auto found = stats.find(entry);
+        return found == stats.end() ? EntryAccess {} : found->second;
+    };
+    if (policy == Eviction::LeastRecentlyUsed)
+        std::stable_sort(candidates.begin(), candidates.end(), [&](const auto& a, const auto& b) { return usage(a).last < usage(b).last; });
+    else
+        std::stable_sort(candidates.begin(), candidates.end(), [&](const auto& a, const auto& b) { return usage(a).count < usage(b).count; });
+    return candidates;
+}
+
+unsigned long long Clipboard::entrySize(const unsigned long& entry) {
+    if (auto location = segmentsHolding(entry).find(entry)) return location->length;
+    return totalDirectorySize(entryDirectoryFor(entry));
+}
+
+void Clipboard::evictEntry(const unsigned long& entry) {
+    getLock(); // readers don't take the lock up front, so only take it once there's something to remove
+    auto& totals = manifest().totals;
+    if (totals) {
+        auto size = entrySize(entry);
+        totals->bytes -= std::min<unsigned long long>(totals->bytes, size);
+        if (totals->entries > 0) totals->entries--;
+    }
+    if (auto& segments = segmentsHolding(entry); segments.find(entry))
+        segments.erase(entry);
+    else {
+        auto entryPath = entryDirectoryFor(entry);
+        removeRecursively(entryPath);
+        std::error_code ec;
+        if (entryPath.parent_path().extension() == constants.shard_extension) fs::remove(entryPath.parent_path(), ec); // only goes through once the shard is empty
+    }
+    if (auto position = std::find(entryIndex.begin(), entryIndex.end(), entry); position != entryIndex.end()) entryIndex.erase(position);
+    cold_entries.erase(entry);
+    if (access_stats) access_stats->erase(entry);
+}
+
+void Clipboard::demoteEntry(const unsigned long& entry) {
+    auto& hot = segmentsFor(root);
+    if (auto location = hot.find(entry)) {
+        auto& cold = segmentsFor(cold_root);
+        if (!cold.find(entry)) cold.append(entry, hot.read(location.value()), location->writeTime());
+        hot.erase(entry);
+        return;
+    }
+
+    auto from = entryDirectoryFor(entry);
+    auto to = coldEntryDirectoryFor(entry);
+    std::error_code ec;
+    if (!fs::exists(to)) {
+        // the copy only shows up in the cold tier once it's complete, and a leftover from an interrupted demotion just gets redone
+        auto staging = to.parent_path() / ("." + std::to_string(entry) + std::string(constants.staging_extension));
+        removeRecursively(staging, ec);
+        createDirectories(staging);
+        auto codec = configuredCodec() != Codec::None ? configuredCodec() : preferredCodec();
+        for (const auto& item : fs::directory_iterator(from)) {
+            auto target = staging / item.path().filename();
+            if (item.path().filename() == constants.data_file_name && codec != Codec::None && item.file_size() >= minimum_compressible_size) {
+                // the data can be as big as whatever was piped in, so it goes through the codec a chunk at a time, and the first chunk is enough to tell what it is
+                std::ifstream input(item.path(), std::ios::binary);
+                std::vector<char> buffer(65536);
+                input.read(buffer.data(), buffer.size());
+                if (!isAlreadyCompressed({buffer.data(), static_cast<size_t>(input.gcount())})) {
+                    bool first = true;
+                    compressToFile(
+                            fs::path(target).concat(codecExtension(codec)),
+                            [&]() -> std::string_view {
+                                if (!std::exchange(first, false)) input.read(buffer.data(), buffer.size());
+                                return {buffer.data(), static_cast<size_t>(input.gcount())};
+                            },
+                            codec
+                    );
+                    continue;
+                }
+            }
+            cowCopy(item.path(), target);
+        }
+        fs::last_write_time(staging, fs::last_write_time(from));
+        renamePath(staging, to);
+        recordWrittenFile(to.parent_path());
+    }
+    removeRecursively(from);
+    if (from.parent_path().extension() == constants.shard_extension) fs::remove(from.parent_path(), ec);
+}
+
+void Clipboard::demoteColdEntries() {
+    auto limits = hotTierLimits();
+    if (!limits || cold_root.empty() || !holds_lock) return;
+    indexAllEntries(false); // only the entries still in RAM count toward its budget
+
+    // keep the newest entries that fit and move everything older than them, but never the current entry
+    std::vector<unsigned long> demoted;
+    unsigned long kept = 0;
+    unsigned long long keptBytes = 0;
+    auto pinned = entriesHoldingMovedItems();
+    for (unsigned long entry = 0; entry < entryIndex.size(); entry++) {
+        auto number = entryIndex.at(entry);
+        if (cold_entries.contains(number) || staged_entry == number || pinned.contains(number)) continue;
+        if (demoted.empty()) {
+            auto segment = segmentsFor(root).find(number);
+            kept++;
+            keptBytes += segment ? segment->length : totalDirectorySize(entryDirectoryFor(number));
+            if (entry == 0 || ((limits->entries == 0 || kept <= limits->entries) && (limits->bytes == 0 || keptBytes <= limits->bytes))) continue;
         }
+        demoted.emplace_back(number);
+    }
+    if (demoted.empty()) return;
+
+#if defined(__linux__)
+    // demoting means copying and compressing, so a cb of its own does it in a new session and this process exits right away, while that one waits for the lock
+    if (!getenv("CLIPBOARD_DEMOTE")) {
+        std::vector<std::string> environment {"CLIPBOARD_DEMOTE=" + this_name};
+        for (auto variable = environ; *variable; variable++)
+            if (!std::string_view(*variable).starts_with("CLIPBOARD_DEMOTE=")) environment.emplace_back(*variable);
+        std::vector<char*> variables;
+        for (auto& variable : environment)
+            variables.emplace_back(variable.data());
+        variables.emplace_back(nullptr);
+        std::array<char*, 2> arguments {const_cast<char*>("cb"), nullptr};
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        for (const auto& descriptor : {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO})
+            posix_spawn_file_actions_addopen(&actions, descriptor, "/dev/null", descriptor == STDIN_FILENO ? O_RDONLY : O_WRONLY, 0);
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSID);
+        pid_t helper;
+        auto spawned = posix_spawn(&helper, "/proc/self/exe", &actions, &attributes, arguments.data(), variables.data()) == 0;
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        if (spawned) return; // otherwise it just happens here
     }
-}
\ No newline at end of file
+#endif
+    try {
+        for (const auto& entry : demoted) {
+            auto hotSize = manifest().totals ? entrySize(entry) : 0;
+            demoteEntry(entry);
+            cold_entries.emplace(entry);
+            if (auto& totals = manifest().totals) totals->bytes = totals->bytes - std::min<unsigned long long>(totals->bytes, hotSize) + entrySize(entry);
+        }
+        segmentsFor(root).compact();
+        if (manifest().totals) saveManifest();
+    } catch (...) {}
+}
+
+size_t Clipboard::totalSize() {
+    std::error_code ec;
+    if (cold_root.empty() || !fs::exists(cold_root, ec)) return totalDirectorySize(root);
+    return totalDirectorySize(root) + totalDirectorySize(cold_root);
+}
@@ -17,16 +17,22 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <bitset>
 #include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <cwchar>
 #include <deque>
 #include <filesystem>
 #include <functional>
+#include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <regex>
 #include <string_view>
 #include <thread>
+#include <unordered_set>
 #include <valarray>
 #include <vector>
 
@@ -90,6 +96,8 @@ struct Constants {
     std::string_view data_file_name = "rawdata.clipboard";
     std::string_view persistent_directory_name = ".local/state/clipboard";
     std::string_view original_files_name = "originals";
+    std::string_view moved_files_name = "moved";
+    std::string_view in_progress_name = "inprogress";
     std::string_view notes_name = "notes";
     std::string_view mime_name = "mime";
     std::string_view ignore_regex_name = "ignore";
@@ -103,9 +111,26 @@ struct Constants {
     std::string_view temporary_directory_name = "Clipboard";
     std::string_view default_clipboard_name = "0";
     std::string_view storage_protocol_version_name = "version";
+    std::string_view manifest_name = "manifest";
+    std::string_view manifest_signature {"CBMF\x00\x01", 6};
+    std::string_view segments_directory = "segments";
+    std::string_view segment_index_name = "index";
+    std::string_view segment_extension = ".segment";
+    std::string_view staging_extension = ".staging";
+    std::string_view entry_counter_name = "counter";
+    std::string_view shard_extension = ".shard";
+    std::string_view cold_tier_directory = "cold";
+    std::string_view access_log_name = "access";
+    std::string_view journal_name = "journal";
+    std::string_view undo_extension = ".undo";
+    std::string_view catalog_name = ".catalog";
+    std::string_view catalog_lock_extension = ".lock";
+    std::string_view catalog_signature {"CBCAT\x00\x02", 7};
+    std::string_view pack_signature {"CBPACK\x00\x01", 8};
 
     unsigned long default_clipboard_entry = 0;
-    std::string_view storage_protocol_version = "1";
+    unsigned long entries_per_shard = 4096;
+    std::string_view storage_protocol_version = "2";
 };
 constexpr Constants constants;
 
@@ -117,6 +142,35 @@ enum class CopyPolicy {
     Unknown
 };
 
+// everything copying files needs to know about them, gathered in one walk so sizing, ignoring, copying and progress don't each walk the items again
+struct CopyPlan {
+    struct Item {
+        fs::path source;
+        fs::path target; // relative to the entry
+        fs::file_type type = fs::file_type::none;
+        unsigned long long size = 0;
+        unsigned long long allocated = 0; // what it takes up on disk, which is less than its size when it has holes
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        bool linked = false; // other hard links to it exist, so another item could be the same file
+    };
+    struct Root {
+        fs::path item;
+        size_t first = 0; // where its items start, the first being the item itself
+        size_t last = 0;
+        bool ignored = false;
+        bool movable = false; // cut from the clipboard's own filesystem, so it gets renamed into the entry and isn't walked unless that fails
+    };
+    std::vector<Root> roots;
+    std::vector<Item> items;
+    std::atomic<unsigned long long> bytes = 0;
+    std::atomic<unsigned long long> copied = 0; // for the progress indicator
+    unsigned long long space = 0; // holes stay holes in the copies, so this is what they need rather than all the bytes
+
+    void build(const std::vector<fs::path>& paths);
+    bool expand(Root& root);
+};
+
 struct Copying {
     bool use_safe_copy = true;
     CopyPolicy policy = CopyPolicy::Unknown;
@@ -125,9 +179,28 @@ struct Copying {
     std::vector<std::pair<std::string, std::error_code>> failedItems;
     std::string buffer;
     std::string mime;
+    CopyPlan plan;
 };
 extern Copying copying;
 
+enum class Codec : unsigned char {
+    None,
+    Zlib,
+    Zstd
+};
+
+enum class PackRecord : unsigned char {
+    End,
+    Clipboard,
+    Directory,
+    File,
+    Symlink
+};
+
+constexpr size_t pack_block_size = 1024 * 1024;
+constexpr size_t raw_preview_size = 65536; // enough to infer a type and fill a terminal line without reading a whole entry
+constexpr size_t minimum_compressible_size = 4096; // anything smaller fits in one filesystem block anyway
+
 std::vector<std::string> regexSplit(const std::string& content, const std::regex& regex);
 
 bool isPersistent(const auto& clipboard) {
@@ -141,6 +214,8 @@ bool isPersistent(const auto& clipboard) {
     return clipboard.find_first_of("_") != std::string::npos;
 }
 
+fs::path coldTierFor(const std::string& clipboard);
+
 static auto thisPID() {
 #if defined(_WIN32) || defined(_WIN64)
     return GetCurrentProcessId();
@@ -151,6 +226,7 @@ static auto thisPID() {
 
 std::optional<std::string> fileContents(const fs::path& path);
 std::vector<std::string> fileLines(const fs::path& path, bool includeEmptyLines = false);
+std::vector<std::string> contentLines(const std::string_view& content, bool includeEmptyLines = false);
 
 bool stopIndicator(bool change_condition_variable = true);
 
@@ -161,6 +237,77 @@ void deduplicate(auto& items) {
 
 size_t writeToFile(const fs::path& path, const std::string& content, bool append = false);
 
+// a cut that moves an item into an entry leaves that entry holding the only copy, so each one is listed as "<entry> <original path>"
+std::vector<std::pair<unsigned long, fs::path>> movedItemsIn(const fs::path& list);
+void saveMovedItems(const fs::path& list, const std::vector<std::pair<unsigned long, fs::path>>& items);
+
+// collects a file's new content out of sight and only puts it in place once it's complete, so an interrupted write leaves the old file untouched
+class AtomicWriter {
+    fs::path target;
+    fs::path temporary; // empty while the content lives in an unnamed O_TMPFILE
+    std::FILE* stream = nullptr;
+
+public:
+    explicit AtomicWriter(const fs::path& target);
+    AtomicWriter(const AtomicWriter&) = delete;
+    ~AtomicWriter();
+    std::FILE* file() const { return stream; }
+    void publish();
+};
+void recordWrittenFile(const fs::path& file);
+void moveWrittenFiles(const fs::path& from, const fs::path& to); // after a rename, so what was written still gets flushed under its new name
+void syncWrittenFiles();
+
+// what a single run needs to know about a path, fetched once no matter how many places ask
+struct FileStatus {
+    bool exists = false;
+    bool is_directory = false;
+    bool is_regular_file = false;
+    uint64_t size = 0;
+    fs::file_time_type write_time;
+};
+FileStatus cachedStatus(const fs::path& file);
+void forgetCachedStatus(const fs::path& file);
+void forgetCachedStatuses();
+// like their std::filesystem namesakes, but they also forget whatever was cached about the paths they change
+void renamePath(const fs::path& from, const fs::path& to);
+void renamePath(const fs::path& from, const fs::path& to, std::error_code& ec);
+std::uintmax_t removeRecursively(const fs::path& path);
+std::uintmax_t removeRecursively(const fs::path& path, std::error_code& ec);
+bool createDirectories(const fs::path& path);
+bool createDirectories(const fs::path& path, std::error_code& ec);
+bool exchangePaths(const fs::path& one, const fs::path& two);
+void swapPaths(const fs::path& one, const fs::path& two); // exchanges them if possible, or else renames or copies them past each other
+bool onSameFilesystem(const fs::path& one, const fs::path& two);
+bool isAlreadyCompressed(const std::string_view& sample);
+Codec preferredCodec();
+Codec configuredCodec();
+std::string_view codecExtension(const Codec& codec);
+void compressToFile(const fs::path& path, const std::string_view& input, const Codec& codec, bool append = false);
+void compressToFile(const fs::path& path, const std::function<std::string_view()>& nextChunk, const Codec& codec, bool append = false);
+void decompressFromFile(const fs::path& path, const Codec& codec, const std::function<bool(const std::string_view&)>& consumer);
+size_t uncompressedLength(const fs::path& path, const Codec& codec);
+bool isRawDataFile(const fs::path& path);
+std::pair<fs::path, Codec> storedRawData(const fs::path& raw);
+std::optional<std::string> rawDataContents(const fs::path& raw, size_t limit = 0);
+bool streamRawData(const fs::path& raw, const std::function<bool(const std::string_view&)>& consumer);
+size_t sizeSetting(const char* name, const size_t& fallback); // a size like 4096, 16kb or 1gb from an environment variable
+size_t streamingThreshold();
+constexpr size_t streaming_step = 8 * 1024 * 1024; // how much of a file above the streaming threshold to read or write before dropping it from the page cache
+bool streamFile(const fs::path& file, const std::function<bool(const std::string_view&)>& consumer);
+bool arrivesGradually(const int& input);
+size_t appendIntoFile(const int& input, const fs::path& file, const bool& tee);
+bool followFile(const fs::path& file, const std::function<bool()>& growing, const std::function<bool(const std::string_view&)>& consumer);
+size_t writeArchive(const fs::path& directory, const int& output);
+size_t readArchive(const int& input, const fs::path& directory);
+std::optional<size_t> rawDataSize(const fs::path& raw);
+size_t writeRawData(const fs::path& raw, const std::string& content, bool append = false);
+std::optional<std::string> compressBlock(const std::string_view& input, const Codec& codec);
+std::string decompressBlock(const std::string_view& input, const size_t& originalSize, const Codec& codec);
+bool reflinkFile(const fs::path& from, const fs::path& to);
+void cowCopyFile(const fs::path& from, const fs::path& to, bool use_regular_copy = true, const std::function<void(const unsigned long long&)>& progress = nullptr);
+void cowCopy(const fs::path& from, const fs::path& to, bool use_regular_copy = true);
+
 extern std::vector<std::string> arguments;
 
 extern std::string clipboard_invocation;
@@ -176,11 +323,15 @@ extern std::string locale;
 extern bool output_silent;
 extern bool progress_silent;
 extern bool confirmation_silent;
+extern bool tee_output;
+extern bool archive_mode;
+extern bool follow_output;
 extern bool no_color;
 extern bool all_option;
 extern bool secret_selection;
 
 extern std::string preferred_mime;
+extern std::string pack_file;
 extern std::vector<std::string> available_mimes;
 extern std::vector<std::string> script_actions;
 extern std::vector<std::string> script_timings;
@@ -295,10 +446,122 @@ public:
 std::string JSONescape(const std::string_view& input);
 std::string formatColors(const std::string_view& str, bool colorful = !no_color);
 
+class SegmentStore {
+public:
+    struct Location {
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t length;
+        int64_t mtime;
+        fs::file_time_type writeTime() const { return fs::file_time_type(fs::file_time_type::duration(mtime)); }
+    };
+
+    explicit SegmentStore(const fs::path& clipboardRoot);
+    SegmentStore(const SegmentStore&) = delete;
+    ~SegmentStore();
+    std::optional<Location> find(const unsigned long& entry) const;
+    std::vector<unsigned long> entries() const;
+    std::string read(const Location& location);
+    void append(const unsigned long& entry, const std::string_view& content, const fs::file_time_type& writeTime);
+    void erase(const unsigned long& entry);
+    void materialize(const unsigned long& entry, const fs::path& entryDirectory);
+    void compact();
+
+private:
+    fs::path directory;
+    std::map<unsigned long, Location> index;
+    std::map<uint64_t, std::FILE*> openSegments;
+    std::mutex readMutex;
+    uint64_t currentSegment = 0;
+    uint64_t liveBytes = 0;
+    uint64_t wastedBytes = 0;
+    void apply(const unsigned long& entry, const std::optional<Location>& location);
+    void appendRecord(const unsigned long& entry, const std::optional<Location>& location);
+    fs::path segmentPath(const uint64_t& segment) const;
+    void closeSegments();
+};
+SegmentStore& segmentsFor(const fs::path& clipboardRoot);
+struct SegmentedEntry {
+    SegmentStore& store;
+    unsigned long entry;
+    SegmentStore::Location location;
+    std::string read() const { return store.read(location); }
+};
+std::optional<SegmentedEntry> segmentedRawData(const fs::path& raw);
+size_t segmentThreshold();
+
+// everything a clipboard knows about itself besides its content, so that it takes a single read to load
+struct Manifest {
+    struct Totals {
+        uint64_t entries;
+        uint64_t bytes;
+    };
+    std::string version {constants.storage_protocol_version};
+    std::optional<std::string> notes;
+    std::optional<std::string> ignore;
+    std::optional<std::string> ignore_secret;
+    std::optional<std::string> script_config;
+    bool sharded = false; // entries live in data/<n / entries_per_shard>.shard/<n> instead of data/<n>
+    std::optional<Totals> totals; // dropped whenever the content changes
+
+    static std::optional<Manifest> load(const fs::path& file);
+    void save(const fs::path& file) const;
+};
+void discardCachedTotals(const fs::path& clipboardRoot);
+
+class IgnoreRules {
+    std::vector<std::regex> regexes;
+    std::optional<std::regex> combined; // all of them at once for matching names, unless they can't be combined
+    std::unordered_set<std::string> secrets; // raw SHA512 digests rather than their hex form
+
+public:
+    IgnoreRules() = default;
+    IgnoreRules(const std::vector<std::string>& patterns, const std::vector<std::string>& hexSecrets);
+    bool empty() const { return regexes.empty() && secrets.empty(); }
+    bool hasRegexes() const { return !regexes.empty(); }
+    bool hasSecrets() const { return !secrets.empty(); }
+    bool ignores(const std::string& item) const;
+    std::string filtered(const std::string& content) const;
+    bool isSecret(const std::string_view& content) const;
+    bool isSecretData(const fs::path& raw) const;
+};
+
 class Clipboard {
     fs::path root;
     std::string this_name;
     unsigned long this_entry;
+    std::shared_ptr<const IgnoreRules> ignore_rules;
+    std::shared_ptr<Manifest> this_manifest;
+    std::optional<unsigned long> staged_entry;
+    std::optional<unsigned long> changed_entry; // an existing entry whose next version is being put together in a staging directory
+    std::unordered_set<unsigned long> misplaced_entries; // entries that sit in the other layout, like ones partway through being sharded
+    std::vector<std::pair<unsigned long, fs::path>> unlisted_shards; // newest first
+    std::vector<unsigned long> held_back_entries; // loose and segmented entries older than the shards listed so far
+    fs::path cold_root;                         // where older entries of a temporary clipboard go once they no longer fit in RAM
+    std::unordered_set<unsigned long> cold_entries;
+    bool cold_tier_unlisted = false;
+    bool holds_lock = false;
+    bool fresh_entry = false; // whether this process made the current entry, so the cached totals only need its size added
+
+    struct EntryAccess {
+        int64_t last = 0; // when the entry was last copied into or pasted from
+        uint64_t count = 0;
+    };
+    std::optional<std::map<unsigned long, EntryAccess>> access_stats;
+
+    void listColdEntries(std::deque<unsigned long>& entries);
+    fs::path coldEntryDirectoryFor(const unsigned long& entry) const;
+    SegmentStore& segmentsHolding(const unsigned long& entry);
+    void demoteEntry(const unsigned long& entry);
+    void appendAccessRecord(const unsigned long& entry, const uint64_t& count);
+    const std::map<unsigned long, EntryAccess>& accessStats();
+    std::vector<unsigned long> evictionOrder();
+    std::unordered_set<unsigned long> entriesHoldingMovedItems();
+    unsigned long long entrySize(const unsigned long& entry);
+    void evictEntry(const unsigned long& entry);
+    fs::path undoPathFor(const unsigned long& entry, const uint64_t& snapshot);
+    void appendJournalRecord(const uint64_t& operation, const unsigned long& entry, const uint64_t& snapshot);
+    bool stepJournal(const bool& forward);
 
 public:
     std::deque<unsigned long> entryIndex;
@@ -322,7 +585,9 @@ public:
     public:
         fs::path ignore;
         fs::path ignore_secret;
+        fs::path in_progress;
         fs::path lock;
+        fs::path moved;
         fs::path notes;
         fs::path originals;
         fs::path script;
@@ -335,6 +600,9 @@ public:
     } metadata;
 
     std::deque<unsigned long> generatedEntryIndex();
+    void indexAllEntries(bool includeColdTier = true);
+    bool listNextShard(bool includeColdTier = true);
+    const unsigned long& entryNumberAt(const unsigned long& entry);
 
     Clipboard() = default;
     Clipboard(const std::string& clipboard_name, const unsigned long& clipboard_entry = constants.default_clipboard_entry);
@@ -347,10 +615,14 @@ public:
     bool holdsDataInCurrentEntry();
     bool holdsIgnoreRegexes();
     bool holdsIgnoreSecrets();
-    std::vector<std::regex> ignoreRegexes();
-    std::vector<std::string> ignoreSecrets();
+    bool holdsScript();
+    const IgnoreRules& ignoreRules();
+    void forgetIgnoreRules() { ignore_rules.reset(); }
     void applyIgnoreRules();
     bool isUnused();
+    Manifest& manifest();
+    void saveManifest();
+    void markContentChanged(bool anyEntry = false);
     bool isLocked() {
         if (!fs::is_regular_file(metadata.lock)) {
             if (fs::exists(metadata.lock)) // Handle the case where the lock file is not a regular file
@@ -363,20 +635,71 @@ public:
         return true;
     }
     void getLock();
-    void releaseLock() { fs::remove(metadata.lock); }
+    void releaseLock();
     std::string name() const { return this_name; }
+    fs::path coldTier() const { return cold_root; }
     unsigned long entry() { return this_entry; }
-    size_t totalEntries() { return entryIndex.size(); }
+    size_t totalEntries() {
+        indexAllEntries();
+        return entryIndex.size();
+    }
     void makeNewEntry();
+    void stageEntryChange();
+    void publishEntry();
+    void publishEntryInProgress();
+    void finishEntryInProgress();
+    void abandonEntryInProgress();
+    bool entryInProgress();
+    void discardStagedEntry();
     void setEntry(const unsigned long& entry);
     fs::path entryPathFor(const unsigned long& entry);
+    fs::path entryDirectoryFor(const unsigned long& entry);
+    void shardEntries();
     bool holdsData();
+    std::optional<SegmentStore::Location> segmentedEntry(const unsigned long& entry);
+    fs::file_time_type entryWriteTime(const unsigned long& entry);
+    void materializeEntry(const unsigned long& entry);
+    void sealEntry(const unsigned long& entry);
     void trimHistoryEntries();
+    void returnMovedItems(const std::optional<unsigned long>& entry = std::nullopt);
+    void makeRoomFor(const unsigned long long& incomingBytes);
+    void recordAccess();
+    unsigned long long storedBytes();
+    void demoteColdEntries();
+    size_t totalSize();
+    void journalNewEntry();
+    void keepForUndo(const unsigned long& entry, const fs::path& previous);
+    void journalSwapWith(Clipboard& other);
+    bool undo();
+    bool redo();
+    void compactJournal();
 };
 extern Clipboard path;
 
+// a summary of every clipboard kept in one file, so status and searching everything don't have to open each clipboard
+struct CatalogRecord {
+    enum class Preview : uint8_t { Empty, Text, Data, Files };
+    std::string name;
+    bool persistent = false;
+    bool holds_data = false; // any entry, not just the current one
+    std::optional<Manifest::Totals> totals;
+    int64_t modified = 0; // when the current entry was last written, in seconds since the epoch
+    Preview kind = Preview::Empty;
+    std::string preview; // the start of the text, "<type>, <size>" for data, or a "d<name>" or "f<name>" line per item
+    std::bitset<256> bytes; // every byte in the text or item names of any entry, so searching can rule a clipboard out unopened
+    uint64_t shortest = std::numeric_limits<uint64_t>::max(); // and the length of the shortest of those texts and names
+
+    static CatalogRecord describe(Clipboard& clipboard, bool everyEntry = false);
+    void summarize(Clipboard& clipboard);
+    bool mightMatch(const std::string& query) const;
+};
+bool isCatalogFile(const fs::path& path);
+std::vector<CatalogRecord> catalogRecords();
+void updateCatalog(Clipboard& clipboard, bool everyEntry = false);
+void discardCatalog();
+
 void incrementSuccessesForItem(const auto& item) {
-    fs::is_directory(item) ? successes.directories++ : successes.files++;
+    cachedStatus(item).is_directory ? successes.directories++ : successes.files++;
 }
 
 class Message {
@@ -425,9 +748,11 @@ void setLanguageFR();
 void setupHandlers();
 void setupTerminal();
 bool isAClearingAction();
+bool isAReadOnlyAction();
 void setClipboardAttributes();
 void setFlags();
 void setFilepaths();
+[[noreturn]] void demoteInBackground(const std::string& clipboard);
 void makeTerminalRaw();
 void makeTerminalNormal();
 unsigned long numberLength(const unsigned long& number);
@@ -453,6 +778,7 @@ void checkForNoItems();
 void startIndicator();
 void indicatorThread();
 void deduplicateItems();
+void planCopy();
 unsigned long long totalItemSize();
 void checkItemSize();
 TerminalSize thisTerminalSize();
@@ -464,12 +790,12 @@ void pasteFiles();
 void clearClipboard();
 void performAction();
 void updateExternalClipboards(bool force = false);
-std::string pipedInContent(bool count = true);
+std::string pipedInContent(bool count = true, bool tee = false);
 void showFailures();
 void showSuccesses();
 [[nodiscard]] CopyPolicy userDecision(const std::string& item);
 void setTheme(const std::string_view& theme);
-size_t totalDirectorySize(const fs::path& directory);
+size_t totalDirectorySize(const fs::path& directory, const bool& allocated = false);
 size_t directoryOverhead(const fs::path& directory);
 void runClipboardScript();
 void checkClipboardScriptEligibility();
@@ -521,7 +847,7 @@ extern bool playAsyncSoundEffect(const std::valarray<short>& samples);
 extern std::optional<std::string> findUsableEditor();
 
 namespace PerformAction {
-void copyItem(const fs::path& f, const bool use_regular_copy = copying.use_safe_copy);
+void copyItem(CopyPlan::Root& root, const bool use_regular_copy = copying.use_safe_copy);
 void copy();
 void copyText();
 void paste();
@@ -557,4 +883,6 @@ void searchJSON();
 void config();
 void script();
 void share();
+void undo();
+void redo();
 } // namespace PerformAction
\ No newline at end of file
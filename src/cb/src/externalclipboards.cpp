@@ -16,7 +16,6 @@
 #include "clipboard.hpp"
 #include <climits>
 #include <fstream>
-#include <openssl/sha.h>
 
 #if defined(_WIN32) || defined(_WIN64)
 #define STDIN_FILENO 0
@@ -109,30 +108,20 @@ ClipboardContent getRemoteClipboard() {
 }
 
 void convertFromGUIClipboard(const std::string& text) {
-    if (fs::exists(path.data.raw) && (fileContents(path.data.raw).value() == text || text.size() == 4096 && fileContents(path.data.raw).value().size() > 4096))
+    if (auto existing = rawDataContents(path.data.raw); existing && (existing.value() == text || text.size() == 4096 && existing.value().size() > 4096))
         return; // check if 4096b long because remote clipboard is up to 4096b long
-    auto regexes = path.ignoreRegexes();
-    for (const auto& regex : regexes)
-        if (std::regex_match(text, regex)) return;
-    auto secrets = path.ignoreSecrets();
-    std::array<unsigned char, SHA512_DIGEST_LENGTH> hash;
-    for (const auto& secret : secrets) {
-        SHA512(reinterpret_cast<const unsigned char*>(text.data()), text.size(), hash.data());
-        std::stringstream ss;
-        for (const auto& byte : hash)
-            ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
-        if (ss.str() == secret) return;
-    }
+    if (const auto& rules = path.ignoreRules(); rules.ignores(text) || rules.isSecret(text)) return;
+    path.getLock();
     path.makeNewEntry();
-    writeToFile(path.data.raw, text);
+    writeRawData(path.data.raw, text);
+    path.publishEntry();
+    path.markContentChanged();
 }
 
 void convertFromGUIClipboard(const ClipboardPaths& clipboard) {
-    auto regexes = path.ignoreRegexes();
+    const auto& rules = path.ignoreRules();
     auto paths = clipboard.paths();
-    for (const auto& regex : regexes)
-        for (auto&& path : paths)
-            if (std::regex_match(path.filename().string(), regex)) paths.erase(std::find(paths.begin(), paths.end(), path));
+    std::erase_if(paths, [&](const auto& path) { return rules.ignores(path.filename().string()); });
 
     // Only clear the temp directory if all files in the clipboard are outside the temp directory
     // This avoids the situation where we delete the very files we're trying to copy
@@ -167,7 +156,10 @@ void convertFromGUIClipboard(const ClipboardPaths& clipboard) {
         return true;
     });
 
-    if (filesHaveChanged && eligibleForCopying && !paths.empty()) path.makeNewEntry();
+    // nothing gets written unless there's a new entry to write, so only then is the lock needed
+    if (!filesHaveChanged || !eligibleForCopying || paths.empty()) return;
+    path.getLock();
+    path.makeNewEntry();
 
     for (auto&& path : paths) {
         if (!fs::exists(path)) continue;
@@ -184,6 +176,8 @@ void convertFromGUIClipboard(const ClipboardPaths& clipboard) {
             } catch (const fs::filesystem_error& e) {} // Give up
         }
     }
+    path.publishEntry();
+    path.markContentChanged(); // only now that the entry holds the files does its size count toward the totals
 
     if (clipboard.action() == ClipboardPathsAction::Cut) {
         std::ofstream originalFiles {path.metadata.originals};
@@ -205,7 +199,11 @@ ClipboardContent thisClipboard() {
 
     if (!copying.buffer.empty()) return {copying.buffer, copying.mime};
 
-    if (default_cb.holdsRawDataInCurrentEntry()) return {fileContents(default_cb.data.raw).value(), std::string(inferMIMEType(fileContents(default_cb.data.raw).value()).value_or("text/plain"))};
+    if (default_cb.holdsRawDataInCurrentEntry()) {
+        auto content = rawDataContents(default_cb.data.raw).value();
+        auto type = std::string(inferMIMEType(content).value_or("text/plain"));
+        return {std::move(content), std::move(type)};
+    }
 
     if (!copying.items.empty()) {
         std::vector<fs::path> paths;
@@ -105,7 +105,8 @@ void indicatorThread() {
     }
 
     auto itemsToProcess = [&] {
-        return std::distance(fs::directory_iterator(path.data), fs::directory_iterator());
+        std::error_code ec; // undoing and redoing can rename the entry away while this counts
+        return std::distance(fs::directory_iterator(path.data, ec), fs::directory_iterator());
     };
 
     static size_t items_size = action_is_one_of(Action::Cut, Action::Copy) ? copying.items.size() : itemsToProcess();
@@ -113,6 +114,8 @@ void indicatorThread() {
     if (items_size == 0) items_size++;
 
     auto percent_done = [&] {
+        // a plan knows how many bytes are left, which moves smoothly even when there's only one big item
+        if (auto planned = copying.plan.bytes.load(); planned > 0) return std::to_string(std::min<unsigned long long>(copying.plan.copied * 100 / planned, 100)) + "%";
         return std::to_string(((successes.files + successes.directories + copying.failedItems.size()) * 100) / items_size) + "%";
     };
 
@@ -168,6 +171,7 @@ void indicatorThread() {
         else
             fprintf(stderr, cancelled_message().data(), actions[action].data());
         fflush(stderr);
+        path.discardStagedEntry();
         path.releaseLock();
         _exit(EXIT_FAILURE);
     }
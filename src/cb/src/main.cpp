@@ -29,6 +29,8 @@ int main(int argc, char* argv[]) {
 
         setFlags();
 
+        if (auto clipboard = getenv("CLIPBOARD_DEMOTE")) demoteInBackground(clipboard);
+
         startIndicator();
 
         verifyClipboardName();
@@ -48,12 +50,16 @@ int main(int argc, char* argv[]) {
 #if defined(__linux__)
         setupGUIClipboardDaemon();
         syncWithRemoteClipboard();
-        if (action != Action::Info) path.getLock();
+        if (!isAReadOnlyAction()) path.getLock();
 #else
-        if (action != Action::Info) path.getLock();
+        if (!isAReadOnlyAction()) path.getLock();
         syncWithExternalClipboards();
 #endif
 
+        if (!isAReadOnlyAction()) path.shardEntries();
+
+        if (!isAReadOnlyAction()) path.materializeEntry(path.entry());
+
         fixMissingItems();
 
         ignoreItemsPreemptively(copying.items);
@@ -64,21 +70,38 @@ int main(int argc, char* argv[]) {
 
         (clipboard_state.exchange(ClipboardState::Action), cv.notify_one());
 
-        (fs::create_directories(global_path.temporary), fs::create_directories(global_path.persistent));
+        (createDirectories(global_path.temporary), createDirectories(global_path.persistent));
 
         if (io_type != IOType::Text) deduplicate(copying.items);
 
-        checkItemSize(totalItemSize());
+        planCopy();
+
+        auto item_size = totalItemSize();
+
+        path.makeRoomFor(item_size);
+
+        checkItemSize(item_size);
 
         checkClipboardScriptEligibility();
 
         runClipboardScript();
 
+        if (action_is_one_of(Action::Add, Action::Remove, Action::Edit)) path.stageEntryChange();
+
         performAction();
 
+        if (action_is_one_of(Action::Paste, Action::Show)) path.recordAccess();
+
         runClipboardScript();
 
-        if (isAWriteAction()) path.applyIgnoreRules();
+        if (isAWriteAction()) {
+            path.applyIgnoreRules();
+            path.markContentChanged();
+        }
+
+        path.publishEntry();
+
+        if (needsANewEntry()) path.journalNewEntry();
 
         copying.mime = getMIMEType();
 
@@ -95,6 +118,10 @@ int main(int argc, char* argv[]) {
         showSuccesses();
 
         path.trimHistoryEntries();
+
+        path.compactJournal();
+
+        path.demoteColdEntries();
     } catch (const std::exception& e) {
         clipboard_state = ClipboardState::Error;
         stopIndicator();
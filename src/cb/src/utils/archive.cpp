@@ -0,0 +1,446 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+#include <charconv>
+
+#if defined(UNIX_OR_UNIX_LIKE)
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
+// archives are plain ustar, with pax records for whatever doesn't fit in its fields, so tar on the other end reads them as is
+#if defined(UNIX_OR_UNIX_LIKE)
+namespace {
+
+constexpr size_t block_size = 512;
+constexpr size_t buffer_size = 1024 * 1024; // the most either direction ever holds in memory
+
+struct TarHeader {
+    char name[100];
+    char mode[8];
+    char uid[8];
+    char gid[8];
+    char size[12];
+    char modified[12];
+    char checksum[8];
+    char type;
+    char link[100];
+    char magic[6];
+    char version[2];
+    char user[32];
+    char group[32];
+    char device_major[8];
+    char device_minor[8];
+    char prefix[155];
+    char padding[12];
+};
+static_assert(sizeof(TarHeader) == block_size);
+
+std::error_code lastError() {
+    return std::error_code(errno, std::generic_category());
+}
+
+template <size_t length>
+bool writeOctal(char (&field)[length], const unsigned long long& value) {
+    if (value >> ((length - 1) * 3) != 0) return false;
+    snprintf(field, length, "%0*llo", static_cast<int>(length - 1), value);
+    return true;
+}
+
+template <size_t length>
+std::string_view fieldText(const char (&field)[length]) {
+    return {field, strnlen(field, length)};
+}
+
+template <size_t length>
+unsigned long long readNumber(const char (&field)[length]) {
+    // GNU tar stores numbers that don't fit in octal as big-endian binary, marked by the high bit
+    if (static_cast<unsigned char>(field[0]) & 0x80) {
+        unsigned long long value = static_cast<unsigned char>(field[0]) & 0x7f;
+        for (size_t i = 1; i < length; i++)
+            value = (value << 8) | static_cast<unsigned char>(field[i]);
+        return value;
+    }
+    unsigned long long value = 0;
+    for (auto digit : fieldText(field))
+        if (digit >= '0' && digit <= '7') value = value * 8 + (digit - '0');
+    return value;
+}
+
+unsigned int checksumOf(const TarHeader& header) {
+    TarHeader copy = header;
+    std::memset(copy.checksum, ' ', sizeof(copy.checksum));
+    unsigned int sum = 0;
+    for (auto byte : std::string_view(reinterpret_cast<const char*>(&copy), sizeof(copy)))
+        sum += static_cast<unsigned char>(byte);
+    return sum;
+}
+
+// a pax record counts its own length, which can push the length to another digit
+std::string paxRecord(const std::string_view& key, const std::string_view& value) {
+    auto body = " " + std::string(key) + "=" + std::string(value) + "\n";
+    auto length = body.size() + 1;
+    while (std::to_string(length).size() + body.size() != length)
+        length = std::to_string(length).size() + body.size();
+    return std::to_string(length) + body;
+}
+
+class ArchiveWriter {
+    int output;
+    size_t total = 0;
+
+    void emit(const char* data, size_t size) {
+        while (size > 0) {
+            auto written = ::write(output, data, size);
+            if (written == -1 && errno == EINTR) continue;
+            if (written <= 0) throw fs::filesystem_error("Couldn't write the archive", lastError());
+            data += written;
+            size -= written;
+            total += written;
+        }
+    }
+
+    void pad(const unsigned long long& size) {
+        static const std::array<char, block_size> zeros {};
+        if (auto rest = size % block_size) emit(zeros.data(), block_size - rest);
+    }
+
+    void header(const std::string& name, const char& type, const struct stat& info, const unsigned long long& size, const std::string& link = "") {
+        TarHeader header {};
+        std::string records;
+        // ustar splits long names at a slash into a prefix and a name
+        if (name.size() <= sizeof(header.name))
+            std::memcpy(header.name, name.data(), name.size());
+        else if (auto slash = name.find('/', name.size() - sizeof(header.name) - 1);
+                 slash != std::string::npos && slash <= sizeof(header.prefix) && name.size() - slash - 1 <= sizeof(header.name) && slash != name.size() - 1) {
+            std::memcpy(header.prefix, name.data(), slash);
+            std::memcpy(header.name, name.data() + slash + 1, name.size() - slash - 1);
+        } else {
+            records += paxRecord("path", name);
+            std::memcpy(header.name, name.data(), sizeof(header.name));
+        }
+        if (link.size() <= sizeof(header.link))
+            std::memcpy(header.link, link.data(), link.size());
+        else
+            records += paxRecord("linkpath", link);
+        if (!writeOctal(header.size, size)) records += paxRecord("size", std::to_string(size));
+        writeOctal(header.mode, info.st_mode & 07777);
+        writeOctal(header.uid, info.st_uid) || writeOctal(header.uid, 0);
+        writeOctal(header.gid, info.st_gid) || writeOctal(header.gid, 0);
+        writeOctal(header.modified, info.st_mtime > 0 ? info.st_mtime : 0);
+        header.type = type;
+        std::memcpy(header.magic, "ustar", 6);
+        std::memcpy(header.version, "00", 2);
+
+        if (!records.empty()) {
+            TarHeader extended {};
+            std::string extendedName = "PaxHeaders/" + fs::path(name).filename().string();
+            std::memcpy(extended.name, extendedName.data(), std::min(extendedName.size(), sizeof(extended.name)));
+            writeOctal(extended.mode, 0644);
+            writeOctal(extended.uid, 0);
+            writeOctal(extended.gid, 0);
+            writeOctal(extended.size, records.size());
+            writeOctal(extended.modified, 0);
+            extended.type = 'x';
+            std::memcpy(extended.magic, "ustar", 6);
+            std::memcpy(extended.version, "00", 2);
+            snprintf(extended.checksum, sizeof(extended.checksum), "%06o", checksumOf(extended));
+            emit(reinterpret_cast<const char*>(&extended), block_size);
+            emit(records.data(), records.size());
+            pad(records.size());
+        }
+        snprintf(header.checksum, sizeof(header.checksum), "%06o", checksumOf(header));
+        emit(reinterpret_cast<const char*>(&header), block_size);
+    }
+
+    void contents(const fs::path& file, const unsigned long long& size) {
+        int input = open(file.string().data(), O_RDONLY | O_CLOEXEC);
+        if (input == -1) throw fs::filesystem_error("Couldn't archive file", file, lastError());
+        unsigned long long sent = 0;
+#if defined(__linux__)
+        // sendfile hands the file's pages to the output directly, without reading them into a buffer first
+        while (sent < size) {
+            auto moved = sendfile(output, input, nullptr, std::min<unsigned long long>(size - sent, 1 << 30));
+            if (moved == -1 && errno == EINTR) continue;
+            if (moved <= 0) break;
+            sent += moved;
+            total += moved;
+        }
+#endif
+        std::vector<char> buffer;
+        while (sent < size) {
+            if (buffer.empty()) buffer.resize(std::min<unsigned long long>(size - sent, buffer_size));
+            auto bytesRead = pread(input, buffer.data(), std::min<unsigned long long>(size - sent, buffer.size()), sent);
+            if (bytesRead == -1 && errno == EINTR) continue;
+            if (bytesRead <= 0) break;
+            emit(buffer.data(), bytesRead);
+            sent += bytesRead;
+        }
+        close(input);
+        // the header already promised this many bytes, so a file that shrank would throw off everything after it
+        if (sent != size) throw fs::filesystem_error("The file changed while it was being archived", file, std::make_error_code(std::errc::io_error));
+        pad(size);
+    }
+
+public:
+    explicit ArchiveWriter(const int& output) : output(output) {}
+
+    size_t write(const fs::path& directory) {
+        std::map<std::pair<dev_t, ino_t>, std::string> linked;
+        for (auto entry = fs::recursive_directory_iterator(directory); entry != fs::recursive_directory_iterator(); entry++) {
+            struct stat info {};
+            if (lstat(entry->path().string().data(), &info) != 0) throw fs::filesystem_error("Couldn't archive item", entry->path(), lastError());
+            auto name = entry->path().lexically_relative(directory).generic_string();
+            if (S_ISDIR(info.st_mode))
+                header(name + "/", '5', info, 0);
+            else if (S_ISLNK(info.st_mode))
+                header(name, '2', info, 0, fs::read_symlink(entry->path()).string());
+            else if (S_ISREG(info.st_mode)) {
+                // other names for a file already in the archive only need a link to it
+                if (info.st_nlink > 1) {
+                    if (auto other = linked.find({info.st_dev, info.st_ino}); other != linked.end()) {
+                        header(name, '1', info, 0, other->second);
+                        continue;
+                    }
+                    linked.emplace(std::make_pair(info.st_dev, info.st_ino), name);
+                }
+                header(name, '0', info, info.st_size);
+                contents(entry->path(), info.st_size);
+            }
+        }
+        static const std::array<char, block_size * 2> end {};
+        emit(end.data(), end.size());
+        return total;
+    }
+};
+
+class ArchiveReader {
+    int input;
+    fs::path directory;
+    bool spliceable = true;
+    size_t total = 0;
+
+    bool fill(char* data, size_t size, const bool& endAllowed = false) {
+        for (size_t done = 0; done < size;) {
+            auto bytesRead = ::read(input, data + done, size - done);
+            if (bytesRead == -1 && errno == EINTR) continue;
+            if (bytesRead == -1) throw fs::filesystem_error("Couldn't read the archive", lastError());
+            if (bytesRead == 0) {
+                if (endAllowed && done == 0) return false;
+                throw std::runtime_error("the archive ends unexpectedly");
+            }
+            done += bytesRead;
+        }
+        return true;
+    }
+
+    void skip(unsigned long long size) {
+        std::vector<char> buffer(std::min<unsigned long long>(size, buffer_size));
+        while (size > 0) {
+            auto part = std::min<unsigned long long>(size, buffer.size());
+            fill(buffer.data(), part);
+            size -= part;
+        }
+    }
+
+    std::string text(const unsigned long long& size) {
+        if (size > buffer_size) throw std::runtime_error("the archive has a header that's too big");
+        std::string content(size, '\0');
+        fill(content.data(), size);
+        skip((block_size - size % block_size) % block_size);
+        return content;
+    }
+
+    void contents(const fs::path& target, const unsigned long long& size) {
+        int file = open(target.string().data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (file == -1) throw fs::filesystem_error("Couldn't create file", target, lastError());
+        unsigned long long left = size;
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+        // from a pipe, splice moves the content into the file without it passing through our own memory
+        while (spliceable && left > 0) {
+            auto moved = splice(input, nullptr, file, nullptr, std::min<unsigned long long>(left, 1 << 30), SPLICE_F_MOVE);
+            if (moved == -1 && errno == EINTR) continue;
+            if (moved == 0) throw std::runtime_error("the archive ends unexpectedly");
+            if (moved == -1) {
+                spliceable = false; // the input isn't a pipe, or the filesystem doesn't take splices
+                break;
+            }
+            left -= moved;
+        }
+#endif
+        std::vector<char> buffer;
+        while (left > 0) {
+            if (buffer.empty()) buffer.resize(std::min<unsigned long long>(left, buffer_size));
+            auto part = std::min<unsigned long long>(left, buffer.size());
+            fill(buffer.data(), part);
+            for (size_t written = 0; written < part;) {
+                auto result = ::write(file, buffer.data() + written, part - written);
+                if (result == -1 && errno == EINTR) continue;
+                if (result == -1) {
+                    close(file);
+                    throw fs::filesystem_error("Couldn't write file", target, lastError());
+                }
+                written += result;
+            }
+            left -= part;
+        }
+        close(file);
+        recordWrittenFile(target);
+        total += size;
+        skip((block_size - size % block_size) % block_size);
+    }
+
+    fs::path targetFor(const std::string& name) {
+        fs::path relative(name);
+        if (relative.is_absolute() || std::any_of(relative.begin(), relative.end(), [](const auto& part) { return part == ".."; }))
+            throw std::runtime_error("the archive contains an unsafe path: " + name);
+        auto target = (directory / relative).lexically_normal();
+        // an earlier symlink in the archive mustn't lead anything after it out of the entry
+        std::error_code ec;
+        if (fs::weakly_canonical(target.parent_path(), ec).lexically_relative(fs::weakly_canonical(directory, ec)).string().starts_with(".."))
+            throw std::runtime_error("the archive contains an unsafe path: " + name);
+        return target;
+    }
+
+public:
+    ArchiveReader(const int& input, const fs::path& directory) : input(input), directory(directory) {}
+
+    size_t read() {
+        struct Directory {
+            fs::path target;
+            fs::perms mode;
+            int64_t modified;
+        };
+        std::vector<Directory> directories;
+        std::optional<std::string> longName, longLink;
+        std::optional<unsigned long long> longSize;
+        auto setModified = [](const fs::path& item, const int64_t& modified) {
+            std::error_code ec;
+            fs::last_write_time(item, fs::file_time_type::clock::from_sys(std::chrono::system_clock::time_point(std::chrono::seconds(modified))), ec);
+        };
+        TarHeader header;
+        while (fill(reinterpret_cast<char*>(&header), block_size, true)) {
+            if (std::all_of(reinterpret_cast<const char*>(&header), reinterpret_cast<const char*>(&header) + block_size, [](const char& byte) { return byte == 0; })) break;
+            if (readNumber(header.checksum) != checksumOf(header)) throw std::runtime_error("the input isn't a tar archive");
+
+            auto size = longSize.value_or(readNumber(header.size));
+            auto name = longName.value_or(
+                    header.prefix[0] == '\0' ? std::string(fieldText(header.name)) : std::string(fieldText(header.prefix)) + "/" + std::string(fieldText(header.name))
+            );
+            auto link = longLink.value_or(std::string(fieldText(header.link)));
+            auto mode = static_cast<fs::perms>(readNumber(header.mode)) & fs::perms::mask;
+            auto modified = static_cast<int64_t>(readNumber(header.modified));
+
+            // these describe the next header instead of being items of their own
+            if (header.type == 'x' || header.type == 'L' || header.type == 'K') {
+                auto content = text(size);
+                if (header.type == 'L')
+                    longName = content.substr(0, content.find('\0'));
+                else if (header.type == 'K')
+                    longLink = content.substr(0, content.find('\0'));
+                else
+                    for (size_t offset = 0; offset < content.size();) {
+                        size_t length = 0;
+                        auto [end, ec] = std::from_chars(content.data() + offset, content.data() + content.size(), length);
+                        if (ec != std::errc() || length == 0 || offset + length > content.size()) break;
+                        std::string_view record(end + 1, content.data() + offset + length - end - 2);
+                        auto key = record.substr(0, record.find('='));
+                        auto value = record.substr(std::min(record.size(), key.size() + 1));
+                        if (key == "path")
+                            longName = std::string(value);
+                        else if (key == "linkpath")
+                            longLink = std::string(value);
+                        else if (key == "size")
+                            longSize = std::stoull(std::string(value));
+                        offset += length;
+                    }
+                continue;
+            }
+            longName.reset();
+            longLink.reset();
+            longSize.reset();
+
+            while (name.starts_with("./"))
+                name.erase(0, 2);
+            // a directory's trailing slash would make every later check on it go through a symlink that took its place
+            while (name.size() > 1 && name.ends_with('/'))
+                name.pop_back();
+            if (name.empty() || name == ".") {
+                skip(size + (block_size - size % block_size) % block_size);
+                continue;
+            }
+            auto target = targetFor(name);
+            std::error_code ec;
+            switch (header.type) {
+            case '5':
+                createDirectories(target);
+                directories.push_back({target, mode, modified});
+                break;
+            case '2':
+                createDirectories(target.parent_path());
+                fs::remove(target, ec);
+                fs::create_symlink(link, target);
+                break;
+            case '1':
+                createDirectories(target.parent_path());
+                fs::remove(target, ec);
+                fs::create_hard_link(targetFor(link), target);
+                break;
+            case '0':
+            case '\0':
+            case '7':
+                createDirectories(target.parent_path());
+                fs::remove(target, ec);
+                contents(target, size);
+                fs::permissions(target, mode, ec);
+                setModified(target, modified);
+                break;
+            default: // devices and fifos don't belong in a clipboard
+                skip(size + (block_size - size % block_size) % block_size);
+            }
+        }
+        // directories last, since a read-only one couldn't have gotten its contents otherwise
+        for (auto item = directories.rbegin(); item != directories.rend(); item++) {
+            std::error_code ec;
+            if (fs::is_symlink(item->target, ec)) continue; // a later symlink took its place, and permissions would go through it
+            fs::permissions(item->target, item->mode, ec);
+            setModified(item->target, item->modified);
+        }
+        return total;
+    }
+};
+
+} // namespace
+
+size_t writeArchive(const fs::path& directory, const int& output) {
+    return ArchiveWriter(output).write(directory);
+}
+
+size_t readArchive(const int& input, const fs::path& directory) {
+    return ArchiveReader(input, directory).read();
+}
+#else
+size_t writeArchive(const fs::path& directory, const int& output) {
+    throw std::runtime_error("archives aren't supported on this platform yet");
+}
+
+size_t readArchive(const int& input, const fs::path& directory) {
+    throw std::runtime_error("archives aren't supported on this platform yet");
+}
+#endif
@@ -0,0 +1,265 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+
+#if defined(UNIX_OR_UNIX_LIKE)
+#include <sys/file.h>
+#endif
+
+namespace {
+
+// a catalog is the signature followed by records of [u32 length][u8 flags][u8 kind][u64 entries][u64 bytes][i64 modified][32 byte set][u64 shortest][u32 name
+// length][name][preview]
+enum Flags : uint8_t { Persistent = 1, HoldsData = 2, HasTotals = 4 };
+constexpr size_t byte_set_size = 256 / 8;
+constexpr size_t fixed_record_size = 2 + 8 + 8 + 8 + byte_set_size + 8 + 4;
+constexpr size_t maximum_preview_size = 1024; // enough for the widest terminals status will draw into
+constexpr size_t maximum_summarized_size = 1 << 20; // bigger content is all but sure to hold every byte, so it isn't worth reading
+
+void appendInteger(std::string& output, const uint64_t& value, const size_t& bytes) {
+    for (size_t i = 0; i < bytes; i++)
+        output.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+uint64_t readInteger(const std::string_view& input, const size_t& bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i])) << (i * 8);
+    return value;
+}
+
+fs::path catalogPath() {
+    return global_path.temporary / constants.catalog_name;
+}
+
+std::string encode(const std::vector<CatalogRecord>& records) {
+    std::string output(constants.catalog_signature);
+    for (const auto& record : records) {
+        std::string content;
+        uint8_t flags = (record.persistent ? Persistent : 0) | (record.holds_data ? HoldsData : 0) | (record.totals ? HasTotals : 0);
+        content.push_back(static_cast<char>(flags));
+        content.push_back(static_cast<char>(record.kind));
+        appendInteger(content, record.totals ? record.totals->entries : 0, 8);
+        appendInteger(content, record.totals ? record.totals->bytes : 0, 8);
+        appendInteger(content, static_cast<uint64_t>(record.modified), 8);
+        for (size_t i = 0; i < byte_set_size; i++)
+            appendInteger(content, ((record.bytes >> (i * 8)) & std::bitset<256>(0xFF)).to_ulong(), 1);
+        appendInteger(content, record.shortest, 8);
+        appendInteger(content, record.name.size(), 4);
+        content.append(record.name);
+        content.append(record.preview);
+        appendInteger(output, content.size(), 4);
+        output.append(content);
+    }
+    return output;
+}
+
+std::optional<std::vector<CatalogRecord>> decode(const std::optional<std::string>& contents) {
+    if (!contents || !contents->starts_with(constants.catalog_signature)) return std::nullopt;
+    std::string_view input(*contents);
+    input.remove_prefix(constants.catalog_signature.size());
+
+    std::vector<CatalogRecord> records;
+    while (input.size() >= 4) {
+        auto length = readInteger(input, 4);
+        input.remove_prefix(4);
+        if (length > input.size() || length < fixed_record_size) return std::nullopt;
+        auto content = input.substr(0, length);
+        input.remove_prefix(length);
+
+        CatalogRecord record;
+        auto flags = static_cast<uint8_t>(content[0]);
+        record.persistent = flags & Persistent;
+        record.holds_data = flags & HoldsData;
+        record.kind = static_cast<CatalogRecord::Preview>(content[1]);
+        if (flags & HasTotals) record.totals = Manifest::Totals {readInteger(content.substr(2), 8), readInteger(content.substr(10), 8)};
+        record.modified = static_cast<int64_t>(readInteger(content.substr(18), 8));
+        for (size_t i = 0; i < byte_set_size; i++)
+            record.bytes |= std::bitset<256>(readInteger(content.substr(26 + i), 1)) << (i * 8);
+        record.shortest = readInteger(content.substr(26 + byte_set_size), 8);
+        auto nameLength = readInteger(content.substr(34 + byte_set_size), 4);
+        if (nameLength > content.size() - fixed_record_size) return std::nullopt;
+        record.name = content.substr(fixed_record_size, nameLength);
+        record.preview = content.substr(fixed_record_size + nameLength);
+        records.emplace_back(std::move(record));
+    }
+    return records;
+}
+
+// the catalog itself is replaced atomically so readers never need this, but two writers must not both read, change and replace it at once
+class CatalogLock {
+#if defined(UNIX_OR_UNIX_LIKE)
+    int fd = -1;
+
+public:
+    CatalogLock() {
+        fd = open((global_path.temporary / (std::string(constants.catalog_name) + std::string(constants.catalog_lock_extension))).string().data(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd != -1) flock(fd, LOCK_EX);
+    }
+    ~CatalogLock() {
+        if (fd != -1) close(fd); // closing drops the lock
+    }
+#endif
+};
+
+std::vector<CatalogRecord> scannedRecords() {
+    std::vector<std::string> names;
+    for (const auto& directory : {global_path.temporary, global_path.persistent}) {
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(directory, ec))
+            if (entry.is_directory(ec) && !isCatalogFile(entry.path())) names.emplace_back(entry.path().filename().string());
+    }
+    // a temporary clipboard's cold tier sits in the persistent directory under the same name
+    deduplicate(names);
+    std::vector<CatalogRecord> records;
+    for (const auto& name : names) {
+        // opening a clipboard creates its directories, so only open the ones that are already there
+        if (cachedStatus((isPersistent(name) ? global_path.persistent : global_path.temporary) / name / constants.metadata_directory).is_directory) {
+            Clipboard clipboard(name);
+            records.emplace_back(CatalogRecord::describe(clipboard, true));
+        } else if (auto cold = coldTierFor(name); !cold.empty() && cachedStatus(cold / constants.data_directory).is_directory) {
+            // all that's left of it is the cold tier, like after a reboot, which search has to open to know what's in it
+            CatalogRecord record;
+            record.name = name;
+            std::error_code ec;
+            record.holds_data = !fs::is_empty(cold / constants.data_directory, ec);
+            record.bytes.set();
+            record.shortest = 0;
+            records.emplace_back(std::move(record));
+        }
+    }
+    return records;
+}
+
+} // namespace
+
+CatalogRecord CatalogRecord::describe(Clipboard& clipboard, bool everyEntry) {
+    CatalogRecord record;
+    record.name = clipboard.name();
+    record.persistent = clipboard.is_persistent;
+    record.totals = clipboard.manifest().totals;
+
+    if (clipboard.holdsRawDataInCurrentEntry()) {
+        std::string content(rawDataContents(clipboard.data.raw, raw_preview_size).value());
+        if (auto type = inferMIMEType(content); type.has_value()) {
+            record.kind = Preview::Data;
+            record.preview = std::string(type.value()) + ", " + formatBytes(rawDataSize(clipboard.data.raw).value());
+        } else {
+            record.kind = Preview::Text;
+            record.preview = content.substr(0, maximum_preview_size);
+        }
+    } else if (clipboard.holdsDataInCurrentEntry()) {
+        record.kind = Preview::Files;
+        for (const auto& entry : fs::directory_iterator(clipboard.data)) {
+            if (record.preview.size() >= maximum_preview_size) break;
+            record.preview += (entry.is_directory() ? "d" : "f") + entry.path().filename().string() + "\n";
+        }
+    }
+    if (record.kind != Preview::Empty)
+        record.modified = std::chrono::system_clock::to_time_t(
+                std::chrono::time_point_cast<std::chrono::system_clock::duration>(std::chrono::file_clock::to_sys(clipboard.entryWriteTime(clipboard.entry())))
+        );
+
+    record.summarize(clipboard);
+    if (everyEntry) {
+        // walk the history the same way search does, then put the clipboard back on the entry it was given with
+        auto current = clipboard.entry();
+        auto currentData = clipboard.data;
+        for (unsigned long entry = 0; entry < clipboard.entryIndex.size() || clipboard.listNextShard(); entry++) {
+            clipboard.setEntry(entry);
+            record.summarize(clipboard);
+        }
+        clipboard.setEntry(current);
+        clipboard.data = currentData;
+    }
+    // only look through the history when the current entry is empty, since that's the rare case
+    record.holds_data = record.kind != Preview::Empty || clipboard.holdsData();
+    return record;
+}
+
+void CatalogRecord::summarize(Clipboard& clipboard) {
+    // the same text and names search compares against, so a byte missing here can't be in anything search would look at
+    auto add = [&](const std::string_view& text) {
+        for (const auto& byte : text)
+            bytes.set(static_cast<unsigned char>(byte));
+        shortest = std::min<uint64_t>(shortest, text.size());
+    };
+    if (clipboard.holdsRawDataInCurrentEntry()) {
+        auto size = rawDataSize(clipboard.data.raw).value_or(0);
+        if (size > maximum_summarized_size) {
+            bytes.set();
+            shortest = std::min<uint64_t>(shortest, size);
+        } else
+            add(rawDataContents(clipboard.data.raw).value_or(""));
+    } else {
+        std::error_code ec;
+        for (const auto& item : fs::directory_iterator(clipboard.data, ec))
+            add(item.path().filename().string());
+    }
+}
+
+bool CatalogRecord::mightMatch(const std::string& query) const {
+    // anything that isn't plain text could be a pattern that matches bytes it doesn't spell out
+    if (query.find_first_of(".^$|()[]{}*+?\\") != std::string::npos) return true;
+    size_t missing = std::count_if(query.begin(), query.end(), [&](const auto& byte) { return !bytes.test(static_cast<unsigned char>(byte)); });
+    if (missing == 0) return true;
+    // otherwise only a fuzzy match is left, which needs under 1000 bytes of content fewer than 25 edits away, and every missing byte is one edit
+    return missing < 25 && shortest < 1000 && shortest < query.size() + 25;
+}
+
+bool isCatalogFile(const fs::path& path) {
+    return path.filename().string().starts_with(constants.catalog_name);
+}
+
+std::vector<CatalogRecord> catalogRecords() {
+    if (auto records = decode(fileContents(catalogPath()))) return records.value();
+    // there's no catalog yet, like right after a reboot empties the temporary directory, so build one from scratch
+    CatalogLock lock;
+    if (auto records = decode(fileContents(catalogPath()))) return records.value();
+    auto records = scannedRecords();
+    try {
+        writeToFile(catalogPath(), encode(records));
+    } catch (const fs::filesystem_error& e) {}
+    return records;
+}
+
+void updateCatalog(Clipboard& clipboard, bool everyEntry) {
+    auto listed = decode(fileContents(catalogPath()));
+    if (!listed) return; // whoever reads it next builds it, and sees this change too
+    // a new record has to cover the whole history, while an existing one only needs what just changed added to it
+    bool known = std::any_of(listed->begin(), listed->end(), [&](const auto& other) { return other.name == clipboard.name(); });
+    auto record = CatalogRecord::describe(clipboard, everyEntry || !known);
+    CatalogLock lock;
+    auto records = decode(fileContents(catalogPath()));
+    if (!records) return;
+    if (auto existing = std::find_if(records->begin(), records->end(), [&](const auto& other) { return other.name == record.name; }); existing != records->end()) {
+        if (!everyEntry) {
+            record.bytes |= existing->bytes;
+            record.shortest = std::min(record.shortest, existing->shortest);
+        }
+        *existing = std::move(record);
+    } else
+        records->insert(std::upper_bound(records->begin(), records->end(), record, [](const auto& a, const auto& b) { return a.name < b.name; }), std::move(record));
+    try {
+        writeToFile(catalogPath(), encode(records.value()));
+    } catch (const fs::filesystem_error& e) {}
+}
+
+void discardCatalog() {
+    CatalogLock lock;
+    std::error_code ec;
+    fs::remove(catalogPath(), ec);
+}
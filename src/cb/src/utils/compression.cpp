@@ -0,0 +1,290 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2024 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+
+#include <memory>
+
+#if defined(USE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(USE_ZSTD)
+#include <zstd.h>
+#endif
+
+bool isAlreadyCompressed(const std::string_view& sample) {
+    constexpr std::array compressedTypes {"application/zip",  "application/epub+zip", "application/gzip", "application/zstd", "application/x-xz", "application/x-bzip2",
+                                          "application/bzip2", "application/x-lz4",   "application/x-7z-compressed", "image/png", "image/jpeg", "image/gif",
+                                          "image/webp",        "image/heic",          "audio/mpeg",       "audio/ogg",        "audio/flac",       "video/mp4",
+                                          "video/mpeg",        "video/webm",          "video/x-matroska"};
+    auto type = inferMIMEType(sample);
+    if (!type) return false;
+    return std::find(compressedTypes.begin(), compressedTypes.end(), type.value()) != compressedTypes.end();
+}
+
+Codec preferredCodec() {
+#if defined(USE_ZSTD)
+    return Codec::Zstd;
+#elif defined(USE_ZLIB)
+    return Codec::Zlib;
+#else
+    return Codec::None;
+#endif
+}
+
+Codec configuredCodec() {
+    static auto codec = [] {
+        auto setting = getenv("CLIPBOARD_COMPRESS");
+        if (!setting) return Codec::None;
+        std::string_view value(setting);
+        if (value.empty() || value == "none" || value == "0" || value == "false") return Codec::None;
+#if defined(USE_ZSTD)
+        if (value == "zstd") return Codec::Zstd;
+#endif
+#if defined(USE_ZLIB)
+        if (value == "zlib" || value == "gzip") return Codec::Zlib;
+#endif
+        return preferredCodec(); // anything else, including a codec this build doesn't have, means "use the best one available"
+    }();
+    return codec;
+}
+
+std::string_view codecExtension(const Codec& codec) {
+    if (codec == Codec::Zlib) return ".gz";
+    if (codec == Codec::Zstd) return ".zst";
+    return "";
+}
+
+std::optional<std::string> compressBlock(const std::string_view& input, const Codec& codec) {
+#if defined(USE_ZLIB)
+    if (codec == Codec::Zlib) {
+        std::string output(compressBound(input.size()), '\0');
+        auto outputSize = static_cast<uLongf>(output.size());
+        if (compress2(reinterpret_cast<Bytef*>(output.data()), &outputSize, reinterpret_cast<const Bytef*>(input.data()), input.size(), Z_BEST_SPEED) != Z_OK) return std::nullopt;
+        if (outputSize >= input.size()) return std::nullopt; // not worth it
+        output.resize(outputSize);
+        return output;
+    }
+#endif
+#if defined(USE_ZSTD)
+    if (codec == Codec::Zstd) {
+        std::string output(ZSTD_compressBound(input.size()), '\0');
+        auto outputSize = ZSTD_compress(output.data(), output.size(), input.data(), input.size(), 1);
+        if (ZSTD_isError(outputSize) || outputSize >= input.size()) return std::nullopt;
+        output.resize(outputSize);
+        return output;
+    }
+#endif
+    return std::nullopt;
+}
+
+std::string decompressBlock(const std::string_view& input, const size_t& originalSize, const Codec& codec) {
+    if (codec == Codec::None) return std::string(input);
+#if defined(USE_ZLIB)
+    if (codec == Codec::Zlib) {
+        std::string output(originalSize, '\0');
+        auto outputSize = static_cast<uLongf>(output.size());
+        if (uncompress(reinterpret_cast<Bytef*>(output.data()), &outputSize, reinterpret_cast<const Bytef*>(input.data()), input.size()) != Z_OK || outputSize != originalSize)
+            throw std::runtime_error("Couldn't decompress a zlib block");
+        return output;
+    }
+#endif
+#if defined(USE_ZSTD)
+    if (codec == Codec::Zstd) {
+        std::string output(originalSize, '\0');
+        auto outputSize = ZSTD_decompress(output.data(), output.size(), input.data(), input.size());
+        if (ZSTD_isError(outputSize) || outputSize != originalSize) throw std::runtime_error("Couldn't decompress a zstd block");
+        return output;
+    }
+#endif
+    throw std::runtime_error("This data needs a compression codec that CB wasn't built with");
+}
+
+namespace {
+
+// every compressed file ends in a frame that the codec itself skips over, which holds how long the data is uncompressed so that's known without decompressing it
+std::string lengthTrailer(const uint64_t& length, const Codec& codec) {
+    std::string encoded;
+    for (size_t byte = 0; byte < sizeof(length); byte++)
+        encoded.push_back(static_cast<char>((length >> (8 * byte)) & 0xff));
+    using namespace std::string_literals;
+    if (codec == Codec::Zstd) return "\x50\x2a\x4d\x18\x08\0\0\0"s + encoded; // a skippable frame
+    // an empty gzip member with the length in its extra field
+    return "\x1f\x8b\x08\x04\0\0\0\0\0\xff\x0c\0CB\x08\0"s + encoded + "\x03\0\0\0\0\0\0\0\0\0"s;
+}
+
+std::optional<uint64_t> trailingLength(const fs::path& path, const Codec& codec) {
+    auto trailerSize = lengthTrailer(0, codec).size();
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(path.string().data(), "rb"), &std::fclose);
+    std::string trailer(trailerSize, '\0');
+    if (!file || std::fseek(file.get(), -static_cast<long>(trailerSize), SEEK_END) != 0 || std::fread(trailer.data(), 1, trailerSize, file.get()) != trailerSize) return std::nullopt;
+    uint64_t length = 0;
+    auto encoded = trailer.substr(codec == Codec::Zstd ? 8 : 16, sizeof(length));
+    for (size_t byte = 0; byte < sizeof(length); byte++)
+        length |= static_cast<uint64_t>(static_cast<unsigned char>(encoded.at(byte))) << (8 * byte);
+    if (trailer != lengthTrailer(length, codec)) return std::nullopt;
+    return length;
+}
+
+} // namespace
+
+size_t uncompressedLength(const fs::path& path, const Codec& codec) {
+    if (auto length = trailingLength(path, codec)) return length.value();
+    // files from before the trailer existed only tell by being decompressed
+    size_t length = 0;
+    decompressFromFile(path, codec, [&](const std::string_view& chunk) {
+        length += chunk.size();
+        return true;
+    });
+    return length;
+}
+
+void compressToFile(const fs::path& path, const std::string_view& input, const Codec& codec, bool append) {
+    size_t offset = 0;
+    compressToFile(
+            path,
+            [&] {
+                auto chunk = input.substr(offset, static_cast<size_t>(1 << 30)); // zlib counts its input in 32 bits
+                offset += chunk.size();
+                return chunk;
+            },
+            codec,
+            append
+    );
+}
+
+void compressToFile(const fs::path& path, const std::function<std::string_view()>& nextChunk, const Codec& codec, bool append) {
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> appended(nullptr, &std::fclose);
+    std::optional<AtomicWriter> replacement;
+    uint64_t length = 0;
+    if (append) {
+        if (fs::exists(path)) length = uncompressedLength(path, codec);
+        appended.reset(std::fopen(path.string().data(), "ab"));
+        if (!appended) throw fs::filesystem_error("Couldn't open file for compression", path, std::error_code(errno, std::generic_category()));
+        recordWrittenFile(path);
+    } else
+        replacement.emplace(path);
+    auto file = append ? appended.get() : replacement->file();
+    std::array<char, 65536> output;
+    auto flushOutput = [&](size_t amount) {
+        if (amount > 0 && std::fwrite(output.data(), 1, amount, file) != amount)
+            throw fs::filesystem_error("Couldn't write compressed data", path, std::error_code(errno, std::generic_category()));
+    };
+    auto finish = [&] {
+        auto trailer = lengthTrailer(length, codec);
+        std::copy(trailer.begin(), trailer.end(), output.begin());
+        flushOutput(trailer.size());
+        if (replacement) replacement->publish();
+    };
+#if defined(USE_ZLIB)
+    if (codec == Codec::Zlib) {
+        // every write is a complete gzip member, so appending just adds another member that readers decompress in sequence
+        z_stream stream {};
+        if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) throw std::runtime_error("Couldn't start zlib compression");
+        int flush;
+        do {
+            auto chunk = nextChunk(); // an empty chunk means there's nothing more
+            length += chunk.size();
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(chunk.data()));
+            stream.avail_in = static_cast<uInt>(chunk.size());
+            flush = chunk.empty() ? Z_FINISH : Z_NO_FLUSH;
+            do {
+                stream.next_out = reinterpret_cast<Bytef*>(output.data());
+                stream.avail_out = output.size();
+                deflate(&stream, flush);
+                flushOutput(output.size() - stream.avail_out);
+            } while (stream.avail_out == 0);
+        } while (flush != Z_FINISH);
+        deflateEnd(&stream);
+        finish();
+        return;
+    }
+#endif
+#if defined(USE_ZSTD)
+    if (codec == Codec::Zstd) {
+        std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> context(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+        ZSTD_CCtx_setParameter(context.get(), ZSTD_c_compressionLevel, 1);
+        ZSTD_EndDirective mode;
+        do {
+            auto chunk = nextChunk();
+            length += chunk.size();
+            mode = chunk.empty() ? ZSTD_e_end : ZSTD_e_continue;
+            ZSTD_inBuffer in {chunk.data(), chunk.size(), 0};
+            size_t remaining;
+            do {
+                ZSTD_outBuffer out {output.data(), output.size(), 0};
+                remaining = ZSTD_compressStream2(context.get(), &out, &in, mode);
+                if (ZSTD_isError(remaining)) throw std::runtime_error(std::string("Couldn't compress with zstd: ") + ZSTD_getErrorName(remaining));
+                flushOutput(out.pos);
+            } while (mode == ZSTD_e_end ? remaining != 0 : in.pos < in.size);
+        } while (mode != ZSTD_e_end);
+        finish();
+        return;
+    }
+#endif
+    throw std::runtime_error("CB wasn't built with this compression codec");
+}
+
+void decompressFromFile(const fs::path& path, const Codec& codec, const std::function<bool(const std::string_view&)>& consumer) {
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(path.string().data(), "rb"), &std::fclose);
+    if (!file) throw fs::filesystem_error("Couldn't open compressed file", path, std::error_code(errno, std::generic_category()));
+    std::array<char, 65536> input;
+    std::array<char, 65536> output;
+    bool keepGoing = true;
+    size_t bytesRead;
+#if defined(USE_ZLIB)
+    if (codec == Codec::Zlib) {
+        z_stream stream {};
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) throw std::runtime_error("Couldn't start zlib decompression");
+        while (keepGoing && (bytesRead = std::fread(input.data(), 1, input.size(), file.get())) > 0) {
+            stream.next_in = reinterpret_cast<Bytef*>(input.data());
+            stream.avail_in = static_cast<uInt>(bytesRead);
+            while (keepGoing && (stream.avail_in > 0 || stream.avail_out == 0)) {
+                stream.next_out = reinterpret_cast<Bytef*>(output.data());
+                stream.avail_out = output.size();
+                auto status = inflate(&stream, Z_NO_FLUSH);
+                if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+                    inflateEnd(&stream);
+                    throw std::runtime_error("Couldn't decompress " + path.string());
+                }
+                if (auto produced = output.size() - stream.avail_out; produced > 0) keepGoing = consumer({output.data(), produced});
+                if (status == Z_STREAM_END) inflateReset(&stream); // the next gzip member came from an append
+                if (status == Z_BUF_ERROR) break;
+            }
+        }
+        inflateEnd(&stream);
+        return;
+    }
+#endif
+#if defined(USE_ZSTD)
+    if (codec == Codec::Zstd) {
+        std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)> context(ZSTD_createDCtx(), &ZSTD_freeDCtx);
+        while (keepGoing && (bytesRead = std::fread(input.data(), 1, input.size(), file.get())) > 0) {
+            ZSTD_inBuffer in {input.data(), bytesRead, 0};
+            ZSTD_outBuffer out {output.data(), output.size(), output.size()};
+            while (keepGoing && (in.pos < in.size || out.pos == out.size)) {
+                out = {output.data(), output.size(), 0};
+                auto status = ZSTD_decompressStream(context.get(), &out, &in);
+                if (ZSTD_isError(status)) throw std::runtime_error("Couldn't decompress " + path.string() + ": " + ZSTD_getErrorName(status));
+                if (out.pos > 0) keepGoing = consumer({output.data(), out.pos});
+                if (out.pos == 0 && in.pos == in.size) break;
+            }
+        }
+        return;
+    }
+#endif
+    throw std::runtime_error("This data needs a compression codec that CB wasn't built with");
+}
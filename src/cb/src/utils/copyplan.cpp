@@ -0,0 +1,171 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+fs::file_type typeFromMode(const mode_t& mode) {
+    if (S_ISDIR(mode)) return fs::file_type::directory;
+    if (S_ISREG(mode)) return fs::file_type::regular;
+    if (S_ISLNK(mode)) return fs::file_type::symlink;
+    return fs::file_type::unknown;
+}
+
+std::error_code lastError() {
+    return std::error_code(errno, std::generic_category());
+}
+
+// symlinks are copied as they are rather than followed, which is what copying with copy_symlinks did
+CopyPlan::Item itemAt(const int& directory, const char* name, const fs::path& source, const fs::path& target) {
+    struct statx info;
+    if (statx(directory, name, AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_INO | STATX_NLINK, &info) != 0) throw fs::filesystem_error("Couldn't plan copying", source, lastError());
+    CopyPlan::Item item;
+    item.source = source;
+    item.target = target;
+    item.type = typeFromMode(info.stx_mode);
+    item.size = item.type == fs::file_type::regular ? info.stx_size : 0;
+    item.allocated = std::min<unsigned long long>(item.size, info.stx_blocks * 512);
+    item.device = makedev(info.stx_dev_major, info.stx_dev_minor);
+    item.inode = info.stx_ino;
+    item.linked = item.type == fs::file_type::regular && info.stx_nlink > 1;
+    return item;
+}
+
+struct DirectoryCloser {
+    void operator()(DIR* stream) const { closedir(stream); }
+};
+
+// readdir reads the directory with large getdents64 calls, and each name is then looked up relative to the directory instead of by its whole path
+void walk(const int& directory, const fs::path& source, const fs::path& target, std::vector<CopyPlan::Item>& items) {
+    int fd = openat(directory, source.filename().string().data(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) throw fs::filesystem_error("Couldn't plan copying", source, lastError());
+    std::unique_ptr<DIR, DirectoryCloser> stream(fdopendir(fd));
+    if (!stream) {
+        close(fd);
+        throw fs::filesystem_error("Couldn't plan copying", source, lastError());
+    }
+    while (auto entry = readdir(stream.get())) {
+        std::string_view name(entry->d_name);
+        if (name == "." || name == "..") continue;
+        items.emplace_back(itemAt(fd, entry->d_name, source / name, target / name));
+        if (items.back().type != fs::file_type::directory) continue;
+        // copies, since walking adds to items and that can move the one we'd otherwise point into
+        auto directorySource = items.back().source, directoryTarget = items.back().target;
+        walk(fd, directorySource, directoryTarget, items);
+    }
+}
+#else
+void walk(const fs::path& source, const fs::path& target, std::vector<CopyPlan::Item>& items) {
+    for (const auto& entry : fs::recursive_directory_iterator(source)) {
+        CopyPlan::Item item;
+        item.source = entry.path();
+        item.target = target / entry.path().lexically_relative(source);
+        item.type = entry.symlink_status().type();
+        if (item.type == fs::file_type::regular) item.allocated = item.size = entry.file_size();
+        items.emplace_back(std::move(item));
+    }
+}
+#endif
+
+CopyPlan::Item rootItem(const fs::path& source, const fs::path& target) {
+#if defined(__linux__)
+    auto parent = source.parent_path();
+    int directory = parent.empty() ? AT_FDCWD : open(parent.string().data(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (directory == -1) throw fs::filesystem_error("Couldn't plan copying", source, lastError());
+    try {
+        auto item = itemAt(directory, source.filename().string().data(), source, target);
+        if (directory != AT_FDCWD) close(directory);
+        return item;
+    } catch (...) {
+        if (directory != AT_FDCWD) close(directory);
+        throw;
+    }
+#else
+    CopyPlan::Item item;
+    item.source = source;
+    item.target = target;
+    item.type = fs::symlink_status(source).type();
+    if (item.type == fs::file_type::not_found) throw fs::filesystem_error("Couldn't plan copying", source, std::make_error_code(std::errc::no_such_file_or_directory));
+    if (item.type == fs::file_type::regular) item.allocated = item.size = fs::file_size(source);
+    return item;
+#endif
+}
+
+} // namespace
+
+void CopyPlan::build(const std::vector<fs::path>& paths) {
+    const auto& rules = path.ignoreRules();
+    // temporary clipboards can be somewhere the system empties, which is no place to move someone's files into
+    bool moving = action == Action::Cut && isPersistent(path.name());
+    for (const auto& item : paths) {
+        // "dir/" names the directory itself
+        auto source = item.filename().empty() ? item.parent_path() : item;
+        Root root {item, items.size(), items.size()};
+        // the same rule applyIgnoreRules uses afterwards, so ignored items never get copied just to be removed again
+        if (rules.hasRegexes() && rules.ignores(source.filename().string())) {
+            root.ignored = true;
+            roots.emplace_back(root);
+            continue;
+        }
+        if (moving && onSameFilesystem(source, path.data)) {
+            root.movable = true;
+            roots.emplace_back(root);
+            continue;
+        }
+        if (expand(root)) roots.emplace_back(root);
+    }
+}
+
+bool CopyPlan::expand(Root& root) {
+    auto source = root.item.filename().empty() ? root.item.parent_path() : root.item;
+    root.first = items.size();
+    try {
+        items.emplace_back(rootItem(source, source.filename()));
+        if (items.back().type == fs::file_type::directory) {
+#if defined(__linux__)
+            auto parent = source.parent_path();
+            int directory = parent.empty() ? AT_FDCWD : open(parent.string().data(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+            if (directory == -1) throw fs::filesystem_error("Couldn't plan copying", source, lastError());
+            try {
+                walk(directory, source, source.filename(), items);
+            } catch (...) {
+                if (directory != AT_FDCWD) close(directory);
+                throw;
+            }
+            if (directory != AT_FDCWD) close(directory);
+#else
+            walk(source, source.filename(), items);
+#endif
+        } else if (items.back().type != fs::file_type::regular && items.back().type != fs::file_type::symlink)
+            throw fs::filesystem_error("Couldn't plan copying", source, std::make_error_code(std::errc::not_supported));
+    } catch (const fs::filesystem_error& e) {
+        items.resize(root.first);
+        copying.failedItems.emplace_back(root.item.string(), e.code());
+        return false;
+    }
+    root.last = items.size();
+    for (auto i = root.first; i < root.last; i++) {
+        bytes += items.at(i).size;
+        space += items.at(i).allocated;
+    }
+    return true;
+}
@@ -14,7 +14,252 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
+#include <charconv>
 #if defined(__linux__)
 #include <linux/fs.h>
 #include <sys/ioctl.h>
 #endif
+
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
+bool reflinkFile(const fs::path& from, const fs::path& to) {
+#if defined(__linux__) && defined(FICLONE)
+    int source = open(from.string().data(), O_RDONLY);
+    if (source == -1) return false;
+    struct stat info;
+    struct stat existing;
+    if (fstat(source, &info) != 0 || (stat(to.string().data(), &existing) == 0 && existing.st_dev == info.st_dev && existing.st_ino == info.st_ino)) {
+        close(source);
+        return false; // truncating the target would empty the source along with it
+    }
+    int target = open(to.string().data(), O_WRONLY | O_CREAT | O_TRUNC, info.st_mode & 07777);
+    if (target == -1) {
+        close(source);
+        return false;
+    }
+    bool cloned = ioctl(target, FICLONE, source) == 0;
+    close(target);
+    close(source);
+    return cloned;
+#elif defined(__APPLE__)
+    std::error_code ec;
+    fs::remove(to, ec);
+    return clonefile(from.string().data(), to.string().data(), 0) == 0;
+#else
+    return false;
+#endif
+}
+
+namespace {
+
+// files at least this big get split into ranges that several threads copy at once, since one stream of requests can't keep a fast drive busy
+size_t rangedCopyThreshold() {
+    static auto threshold = sizeSetting("CLIPBOARD_RANGED_COPY_THRESHOLD", 256 * 1024 * 1024);
+    return threshold;
+}
+
+unsigned int rangedCopyThreads() {
+    static auto threads = [] {
+        unsigned int amount = std::clamp(suitableThreadAmount(), 1u, 8u); // more than this rarely helps a single drive
+        if (auto setting = getenv("CLIPBOARD_COPY_THREADS")) {
+            std::string_view value(setting);
+            if (auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), amount); ec != std::errc() || amount == 0) amount = 1;
+        }
+        return amount;
+    }();
+    return threads;
+}
+
+#if defined(UNIX_OR_UNIX_LIKE)
+constexpr size_t range_step = streaming_step; // how much each thread copies between progress reports
+
+// what's been copied of a file above the streaming threshold is never read again, so it shouldn't push everything else out of the page cache
+void dropCopiedPages(const int& source, const int& target, const off_t& from, const off_t& to, const bool& wait) {
+    if (to <= from) return;
+#if defined(POSIX_FADV_DONTNEED)
+    posix_fadvise(source, from, to - from, POSIX_FADV_DONTNEED);
+#if defined(__linux__)
+    // dirty pages can only be dropped once they're written, so start writing each step right away and wait for it a step later
+    sync_file_range(target, from, to - from, wait ? SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER : SYNC_FILE_RANGE_WRITE);
+#endif
+    if (wait) posix_fadvise(target, from, to - from, POSIX_FADV_DONTNEED);
+#endif
+}
+
+struct RangeMode {
+    bool streaming = false;
+    bool sparse = false;
+};
+
+// copies [offset, end) of one file into another, in the kernel when it can and through a buffer otherwise
+std::error_code copyRange(const int& source, const int& target, off_t offset, const off_t& end, const RangeMode& mode, const std::function<void(const unsigned long long&)>& progress) {
+#if defined(__linux__)
+    bool inKernel = true;
+#endif
+    std::vector<char> buffer;
+    off_t flushed = offset;
+    while (offset < end) {
+        auto extentEnd = end;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+        if (mode.sparse) {
+            // the target starts out as one big hole, so skipping the source's holes leaves them in the copy too
+            auto data = lseek(source, offset, SEEK_DATA);
+            if (data == -1 && errno != ENXIO) return std::error_code(errno, std::generic_category());
+            data = data == -1 ? end : std::min(data, end); // ENXIO means there's only a hole left
+            if (data > offset) {
+                if (progress) progress(data - offset);
+                offset = data;
+                continue;
+            }
+            auto hole = lseek(source, offset, SEEK_HOLE);
+            if (hole == -1) return std::error_code(errno, std::generic_category());
+            extentEnd = std::min(hole, end);
+        }
+#endif
+        auto length = static_cast<size_t>(std::min<off_t>(extentEnd - offset, range_step));
+        ssize_t copied = -1;
+#if defined(__linux__)
+        if (inKernel) {
+            off_t in = offset, out = offset;
+            copied = copy_file_range(source, &in, target, &out, length, 0);
+            if (copied == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) inKernel = false;
+        }
+        if (!inKernel) {
+#endif
+            buffer.resize(length);
+            copied = pread(source, buffer.data(), length, offset);
+            for (ssize_t written = 0; copied > 0 && written < copied;) {
+                auto result = pwrite(target, buffer.data() + written, copied - written, offset + written);
+                if (result == -1) {
+                    if (errno == EINTR) continue;
+                    copied = -1;
+                    break;
+                }
+                written += result;
+            }
+#if defined(__linux__)
+        }
+#endif
+        if (copied == -1 && errno == EINTR) continue;
+        if (copied == -1) return std::error_code(errno, std::generic_category());
+        if (copied == 0) return std::make_error_code(std::errc::io_error); // the file got shorter while copying it
+        if (mode.streaming) {
+            dropCopiedPages(source, target, flushed, offset, true);
+            dropCopiedPages(source, target, offset, offset + copied, false);
+            flushed = offset;
+        }
+        offset += copied;
+        if (progress) progress(copied);
+    }
+    if (mode.streaming) dropCopiedPages(source, target, flushed, offset, true);
+    return {};
+}
+
+bool copyFileInRanges(const fs::path& from, const fs::path& to, const std::function<void(const unsigned long long&)>& progress) {
+    int source = open(from.string().data(), O_RDONLY | O_CLOEXEC);
+    if (source == -1) return false;
+    struct stat info;
+    if (fstat(source, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(source);
+        return false;
+    }
+    bool ranged = rangedCopyThreshold() != 0 && static_cast<size_t>(info.st_size) >= rangedCopyThreshold() && rangedCopyThreads() >= 2;
+    RangeMode mode;
+    mode.streaming = streamingThreshold() != 0 && static_cast<size_t>(info.st_size) >= streamingThreshold();
+    mode.sparse = static_cast<unsigned long long>(info.st_blocks) * 512 < static_cast<unsigned long long>(info.st_size); // fewer blocks than bytes means there are holes
+    if (!ranged && !mode.streaming && !mode.sparse) {
+        close(source);
+        return false;
+    }
+#if defined(POSIX_FADV_SEQUENTIAL)
+    if (mode.streaming) posix_fadvise(source, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    int target = open(to.string().data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, info.st_mode & 07777);
+    if (target == -1 || ftruncate(target, info.st_size) != 0) {
+        auto error = std::error_code(errno, std::generic_category());
+        close(source);
+        if (target != -1) close(target);
+        throw fs::filesystem_error("Couldn't copy file", from, to, error);
+    }
+
+    // whole steps per range so no two threads ever share a block
+    auto ranges = static_cast<off_t>(ranged ? rangedCopyThreads() : 1);
+    auto rangeLength = ((info.st_size / ranges) / range_step + 1) * range_step;
+    std::mutex errorMutex;
+    std::error_code error;
+    std::vector<std::thread> workers;
+    for (off_t start = 0; start < info.st_size; start += rangeLength)
+        workers.emplace_back([&, start] {
+            auto result = copyRange(source, target, start, std::min<off_t>(start + rangeLength, info.st_size), mode, progress);
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (result && !error) error = result;
+        });
+    for (auto& worker : workers)
+        worker.join();
+
+    struct stat copied;
+    if (!error && (fstat(target, &copied) != 0 || copied.st_size != info.st_size)) error = std::make_error_code(std::errc::io_error);
+    close(source);
+    close(target);
+    if (error) throw fs::filesystem_error("Couldn't copy file", from, to, error);
+    return true;
+}
+#else
+bool copyFileInRanges(const fs::path& from, const fs::path& to, const std::function<void(const unsigned long long&)>& progress) {
+    return false;
+}
+#endif
+
+} // namespace
+
+void cowCopyFile(const fs::path& from, const fs::path& to, bool use_regular_copy, const std::function<void(const unsigned long long&)>& progress) {
+    auto reportWhole = [&] {
+        std::error_code ec;
+        if (progress) progress(fs::file_size(to, ec));
+    };
+    std::error_code ec;
+    // a fast copy leaves the target as a hard link to the source, so copying over it again would only empty both
+    if (fs::equivalent(from, to, ec)) return reportWhole();
+    if (!use_regular_copy) {
+        fs::remove(to, ec);
+        fs::create_hard_link(from, to, ec);
+        if (!ec) return reportWhole();
+        if (ec != std::errc::cross_device_link) throw fs::filesystem_error("Couldn't link file", from, to, ec);
+    }
+    // the copy fills up under a hidden name and then replaces the target, so nothing else linked to the target ever sees it half written
+    auto temporary = to.parent_path() / ("." + to.filename().string() + "." + std::to_string(thisPID()) + ".tmp");
+    fs::remove(temporary, ec);
+    try {
+        bool reportedAlready = false;
+        if (!reflinkFile(from, temporary)) {
+            reportedAlready = copyFileInRanges(from, temporary, progress);
+            if (!reportedAlready) fs::copy_file(from, temporary, fs::copy_options::overwrite_existing);
+        }
+        renamePath(temporary, to);
+        if (!reportedAlready) reportWhole();
+    } catch (const fs::filesystem_error&) {
+        fs::remove(temporary, ec);
+        throw;
+    }
+    recordWrittenFile(to);
+}
+
+void cowCopy(const fs::path& from, const fs::path& to, bool use_regular_copy) {
+    auto copyOne = [&](const fs::directory_entry& entry, const fs::path& target) {
+        if (entry.is_symlink()) {
+            std::error_code ec;
+            fs::remove(target, ec);
+            fs::copy_symlink(entry.path(), target);
+        } else if (entry.is_directory())
+            createDirectories(target);
+        else
+            cowCopyFile(entry.path(), target, use_regular_copy);
+    };
+    fs::directory_entry root(from);
+    copyOne(root, to);
+    if (!root.is_directory() || root.is_symlink()) return;
+    for (const auto& entry : fs::recursive_directory_iterator(from))
+        copyOne(entry, to / entry.path().lexically_relative(from));
+}
@@ -30,19 +30,23 @@ size_t directoryOverhead(const fs::path& directory) {
 }
 
 thread_local size_t size = 0; // thread_local because multiple threads could call ftwHandler
+thread_local bool countAllocated = false;
 
 #if defined(UNIX_OR_UNIX_LIKE)
 int ftwHandler(const char* fpath, const struct stat* sb, int typeflag) {
-    size += sb->st_size;
+    // holes in sparse files take up no blocks, so this is what's really on disk
+    size += countAllocated ? static_cast<size_t>(sb->st_blocks) * 512 : sb->st_size;
     return 0;
 }
 #endif
 
-size_t totalDirectorySize(const fs::path& directory) {
-    size = directoryOverhead(directory);
+size_t totalDirectorySize(const fs::path& directory, const bool& allocated) {
 #if defined(UNIX_OR_UNIX_LIKE)
+    size = 0; // ftw visits the directory itself too
+    countAllocated = allocated;
     ftw(directory.string().data(), ftwHandler, 1);
 #else
+    size = directoryOverhead(directory);
     for (const auto& entry : fs::recursive_directory_iterator(directory))
         try {
             size += entry.is_directory() ? directoryOverhead(entry) : entry.file_size();
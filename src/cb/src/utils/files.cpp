@@ -14,7 +14,18 @@
     You should have received a copy of the GNU General Public License
     along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
 #include "../clipboard.hpp"
+#include <charconv>
 #include <fstream>
+#include <memory>
+#include <set>
+#include <utility>
+
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#endif
 
 std::optional<std::string> fileContents(const fs::path& path) {
 #if defined(UNIX_OR_UNIX_LIKE)
@@ -51,11 +62,238 @@ std::optional<std::string> fileContents(const fs::path& path) {
 #endif
 }
 
+size_t sizeSetting(const char* name, const size_t& fallback) {
+    auto setting = getenv(name);
+    if (!setting) return fallback;
+    std::string_view value(setting);
+    size_t bytes;
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), bytes);
+    if (ec != std::errc()) return fallback;
+    std::string unit(ptr, value.data() + value.size());
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+    if (unit == "kb") bytes *= 1024;
+    if (unit == "mb") bytes *= 1024 * 1024;
+    if (unit == "gb") bytes *= 1024 * 1024 * 1024;
+    return bytes;
+}
+
+size_t streamingThreshold() {
+    static auto threshold = sizeSetting("CLIPBOARD_STREAMING_THRESHOLD", 1024 * 1024 * 1024);
+    return threshold;
+}
+
+bool streamFile(const fs::path& file, const std::function<bool(const std::string_view&)>& consumer) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    int fd = open(file.string().data(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat info {};
+    bool streaming = fstat(fd, &info) == 0 && streamingThreshold() != 0 && static_cast<size_t>(info.st_size) >= streamingThreshold();
+#if defined(POSIX_FADV_SEQUENTIAL)
+    // a big file is read once and never again, so read far ahead and let go of what's been read before it pushes everything else out of memory
+    if (streaming) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    // one read for anything up to a megabyte, which is also how big a block in a pack gets
+    std::vector<char> buffer(std::clamp<size_t>(info.st_size, 4096, 1024 * 1024));
+    off_t offset = 0, dropped = 0;
+    while (true) {
+        auto bytesRead = read(fd, buffer.data(), buffer.size());
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead <= 0) break;
+        offset += bytesRead;
+        if (!consumer({buffer.data(), static_cast<size_t>(bytesRead)})) break;
+#if defined(POSIX_FADV_DONTNEED)
+        if (streaming && static_cast<size_t>(offset - dropped) >= streaming_step) {
+            posix_fadvise(fd, dropped, offset - dropped, POSIX_FADV_DONTNEED);
+            dropped = offset;
+        }
+#endif
+    }
+#if defined(POSIX_FADV_DONTNEED)
+    if (streaming) posix_fadvise(fd, dropped, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+    return true;
+#else
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> plain(std::fopen(file.string().data(), "rb"), &std::fclose);
+    if (!plain) return false;
+    std::vector<char> buffer(1024 * 1024);
+    size_t bytesRead;
+    while ((bytesRead = std::fread(buffer.data(), 1, buffer.size(), plain.get())) > 0)
+        if (!consumer({buffer.data(), bytesRead})) break;
+    return true;
+#endif
+}
+
+namespace {
+
+std::optional<size_t> teeIntoFile(const int& input, const int& output, const int& target, const fs::path& file) {
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+    // tee(2) only works from one pipe into another
+    struct stat inputInfo {}, outputInfo {};
+    if (fstat(input, &inputInfo) != 0 || fstat(output, &outputInfo) != 0 || !S_ISFIFO(inputInfo.st_mode) || !S_ISFIFO(outputInfo.st_mode)) return std::nullopt;
+    auto failed = [&] { throw fs::filesystem_error("Couldn't store piped content", file, std::error_code(errno, std::generic_category())); };
+    size_t total = 0;
+    bool spliceable = true;
+    // splice moves what's waiting in the input straight into the file, so the content never passes through our own memory
+    auto store = [&](const size_t& length) -> size_t {
+        ssize_t moved = -1;
+        while (spliceable && (moved = splice(input, nullptr, target, nullptr, length, SPLICE_F_MOVE)) == -1 && errno == EINTR) {}
+        if (moved == -1 && spliceable && errno != EINVAL) failed();
+        if (moved == -1) {
+            spliceable = false; // some filesystems can't take a splice, and tee already sent this part along so it can't go back
+            std::vector<char> buffer(length);
+            while ((moved = read(input, buffer.data(), length)) == -1 && errno == EINTR) {}
+            if (moved == -1) failed();
+            for (ssize_t written = 0, done = 0; done < moved; done += written)
+                if ((written = write(target, buffer.data() + done, moved - done)) == -1) failed();
+        }
+        total += moved;
+        successes.bytes += moved;
+        return moved;
+    };
+    constexpr size_t step = 1024 * 1024;
+    bool forwarding = true;
+    while (true) {
+        if (!forwarding) {
+            if (store(step) == 0) break;
+            continue;
+        }
+        // tee copies what's waiting in the input into the output without taking it out of the input
+        auto teed = tee(input, output, step, 0);
+        if (teed == -1 && errno == EINTR) continue;
+        if (teed == -1 && errno == EINVAL && total == 0) return std::nullopt;
+        if (teed == -1 && errno == EPIPE) {
+            forwarding = false; // whatever reads from us went away, but the content still gets stored
+            continue;
+        }
+        if (teed == -1) failed();
+        if (teed == 0) break;
+        for (size_t left = teed, moved = 1; left > 0 && moved > 0; left -= moved)
+            moved = store(left);
+    }
+    return total;
+#else
+    return std::nullopt;
+#endif
+}
+
+} // namespace
+
+bool arrivesGradually(const int& input) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    struct stat info {};
+    return fstat(input, &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode));
+#else
+    return false;
+#endif
+}
+
+size_t appendIntoFile(const int& input, const fs::path& file, const bool& tee) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    // unlike an AtomicWriter, every chunk lands in the file itself as soon as it arrives, so it can be read while more is still coming
+    int target = open(file.string().data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    auto failed = [&] { throw fs::filesystem_error("Couldn't store piped content", file, std::error_code(errno, std::generic_category())); };
+    if (target == -1) failed();
+    std::optional<size_t> total;
+    try {
+        if (tee) total = teeIntoFile(input, fileno(stdout), target, file);
+        bool forwarding = tee;
+        size_t stored = 0;
+        std::array<char, 65536> buffer;
+        while (!total) {
+            auto bytesRead = read(input, buffer.data(), buffer.size());
+            if (bytesRead == -1 && errno == EINTR) continue;
+            if (bytesRead == -1) failed();
+            if (bytesRead == 0) total = stored;
+            for (ssize_t written = 0, done = 0; done < bytesRead; done += written)
+                if ((written = write(target, buffer.data() + done, bytesRead - done)) == -1) failed();
+            for (ssize_t written = 0, done = 0; forwarding && done < bytesRead; done += written)
+                if ((written = write(fileno(stdout), buffer.data() + done, bytesRead - done)) == -1) forwarding = false; // the reader went away, but the content still gets stored
+            stored += bytesRead;
+            successes.bytes += bytesRead;
+        }
+    } catch (...) {
+        close(target);
+        throw;
+    }
+    close(target);
+    recordWrittenFile(file);
+    return total.value();
+#else
+    auto content = pipedInContent(true, tee);
+    writeToFile(file, content);
+    return content.size();
+#endif
+}
+
+bool followFile(const fs::path& file, const std::function<bool()>& growing, const std::function<bool(const std::string_view&)>& consumer) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    int fd = open(file.string().data(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+#if defined(__linux__)
+    // inotify wakes us up as soon as there's more to read, so nothing gets checked over and over while the writer is quiet
+    int watcher = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher != -1 && inotify_add_watch(watcher, file.string().data(), IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE_SELF) == -1) {
+        close(watcher);
+        watcher = -1;
+    }
+#endif
+    std::array<char, 65536> buffer;
+    bool wanted = true;
+    while (wanted) {
+        // checked before reading, so whatever the writer added before finishing always gets read
+        bool writing = growing();
+        while (wanted) {
+            auto bytesRead = read(fd, buffer.data(), buffer.size());
+            if (bytesRead == -1 && errno == EINTR) continue;
+            if (bytesRead <= 0) break;
+            wanted = consumer({buffer.data(), static_cast<size_t>(bytesRead)});
+        }
+        if (!writing) break;
+#if defined(__linux__)
+        if (watcher != -1) {
+            // the timeout only matters if the writer dies without saying so
+            pollfd waiting {watcher, POLLIN, 0};
+            if (poll(&waiting, 1, 1000) > 0) {
+                std::array<char, 4096> events;
+                while (read(watcher, events.data(), events.size()) > 0) {}
+            }
+            continue;
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+#if defined(__linux__)
+    if (watcher != -1) close(watcher);
+#endif
+    close(fd);
+    return true;
+#else
+    std::ifstream stream(file, std::ios::binary);
+    if (!stream.is_open()) return false;
+    std::vector<char> buffer(65536);
+    bool wanted = true;
+    while (wanted) {
+        bool writing = growing();
+        while (wanted && (stream.read(buffer.data(), buffer.size()) || stream.gcount() > 0))
+            wanted = consumer({buffer.data(), static_cast<size_t>(stream.gcount())});
+        stream.clear(); // reaching the end isn't final while something's still writing
+        if (!writing) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return true;
+#endif
+}
+
 std::vector<std::string> fileLines(const fs::path& path, bool includeEmptyLines) {
-    std::vector<std::string> lines;
     auto content = fileContents(path);
-    if (!content) return lines;
-    std::istringstream stream(*content);
+    if (!content) return {};
+    return contentLines(*content, includeEmptyLines);
+}
+
+std::vector<std::string> contentLines(const std::string_view& content, bool includeEmptyLines) {
+    std::vector<std::string> lines;
+    std::istringstream stream {std::string(content)};
     for (std::string line; std::getline(stream, line);) {
         if (!line.empty() || includeEmptyLines) lines.emplace_back(line);
     }
@@ -63,7 +301,308 @@ std::vector<std::string> fileLines(const fs::path& path, bool includeEmptyLines)
 }
 
 size_t writeToFile(const fs::path& path, const std::string& content, bool append) {
-    std::ofstream file(path, append ? std::ios::app : std::ios::trunc | std::ios::binary);
-    file << content;
+    if (append) {
+        std::ofstream file(path, std::ios::app);
+        file << content;
+        recordWrittenFile(path);
+        return content.size();
+    }
+    AtomicWriter writer(path);
+    if (std::fwrite(content.data(), 1, content.size(), writer.file()) != content.size())
+        throw fs::filesystem_error("Couldn't write file", path, std::error_code(errno, std::generic_category()));
+    writer.publish();
     return content.size();
-}
\ No newline at end of file
+}
+
+#if defined(__linux__) && defined(O_TMPFILE)
+namespace {
+// gives an O_TMPFILE's content a name when linking it isn't possible
+bool copyUnnamedFile(const int& source, const fs::path& target) {
+    int fd = open(target.string().data(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd == -1) return false;
+    auto failed = [&] {
+        auto error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    };
+    std::array<char, 65536> buffer;
+    off_t offset = 0;
+    while (true) {
+        auto bytesRead = pread(source, buffer.data(), buffer.size(), offset);
+        if (bytesRead == -1 && errno == EINTR) continue;
+        if (bytesRead == -1) return failed();
+        if (bytesRead == 0) break;
+        for (ssize_t written = 0; written < bytesRead;) {
+            auto result = write(fd, buffer.data() + written, bytesRead - written);
+            if (result == -1 && errno == EINTR) continue;
+            if (result == -1) return failed();
+            written += result;
+        }
+        offset += bytesRead;
+    }
+    return close(fd) == 0;
+}
+} // namespace
+#endif
+
+AtomicWriter::AtomicWriter(const fs::path& target) : target(target) {
+    auto directory = target.has_parent_path() ? target.parent_path() : fs::path(".");
+#if defined(__linux__) && defined(O_TMPFILE)
+    if (int fd = open(directory.string().data(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0666); fd != -1) {
+        stream = fdopen(fd, "wb");
+        if (stream) return;
+        close(fd);
+    }
+#endif
+    // not every filesystem supports O_TMPFILE, so fall back to a hidden name next to the target
+    temporary = directory / ("." + target.filename().string() + "." + std::to_string(thisPID()) + ".tmp");
+    stream = std::fopen(temporary.string().data(), "wb");
+    if (!stream) throw fs::filesystem_error("Couldn't create file", temporary, std::error_code(errno, std::generic_category()));
+}
+
+AtomicWriter::~AtomicWriter() {
+    if (!stream) return;
+    std::fclose(stream);
+    std::error_code ec;
+    if (!temporary.empty()) fs::remove(temporary, ec);
+}
+
+void AtomicWriter::publish() {
+    auto failed = [&](const std::string_view& what) {
+        throw fs::filesystem_error(std::string(what), target, std::error_code(errno, std::generic_category()));
+    };
+    if (std::fflush(stream) != 0) failed("Couldn't write file");
+#if defined(__linux__) && defined(O_TMPFILE)
+    if (temporary.empty()) {
+        auto procPath = "/proc/self/fd/" + std::to_string(fileno(stream));
+        if (linkat(AT_FDCWD, procPath.data(), AT_FDCWD, target.string().data(), AT_SYMLINK_FOLLOW) == 0) {
+            std::fclose(std::exchange(stream, nullptr));
+            recordWrittenFile(target);
+            return;
+        }
+        auto linkError = errno;
+        // linkat never replaces an existing file, so give the content a name of its own first and rename that over the target
+        temporary = target.parent_path() / ("." + target.filename().string() + "." + std::to_string(thisPID()) + ".tmp");
+        std::error_code ec;
+        fs::remove(temporary, ec);
+        // without /proc, or on filesystems that can't link an unnamed file, that name gets a copy of the content instead
+        if ((linkError != EEXIST || linkat(AT_FDCWD, procPath.data(), AT_FDCWD, temporary.string().data(), AT_SYMLINK_FOLLOW) != 0) && !copyUnnamedFile(fileno(stream), temporary)) {
+            auto copyError = errno;
+            fs::remove(temporary, ec);
+            temporary.clear();
+            errno = copyError;
+            failed("Couldn't publish file");
+        }
+    }
+#endif
+    if (std::fclose(std::exchange(stream, nullptr)) != 0) failed("Couldn't write file");
+    renamePath(temporary, target);
+    temporary.clear();
+    recordWrittenFile(target);
+}
+
+namespace {
+std::mutex writtenFilesMutex;
+std::vector<fs::path> writtenFiles;
+} // namespace
+
+void recordWrittenFile(const fs::path& file) {
+    forgetCachedStatus(file);
+    if (!envVarIsTrue("CLIPBOARD_DURABLE")) return;
+    std::lock_guard<std::mutex> lock(writtenFilesMutex);
+    writtenFiles.emplace_back(file);
+}
+
+void moveWrittenFiles(const fs::path& from, const fs::path& to) {
+    if (!envVarIsTrue("CLIPBOARD_DURABLE")) return;
+    std::lock_guard<std::mutex> lock(writtenFilesMutex);
+    for (auto& file : writtenFiles) {
+        auto relative = file.lexically_relative(from);
+        if (relative.empty() || *relative.begin() == "..") continue;
+        file = relative == "." ? to : to / relative;
+    }
+    writtenFiles.emplace_back(to); // the directory holding it now has a new name in it too
+}
+
+void syncWrittenFiles() {
+    std::lock_guard<std::mutex> lock(writtenFilesMutex);
+    if (writtenFiles.empty()) return;
+    deduplicate(writtenFiles);
+    std::vector<fs::path> directories;
+    for (const auto& file : writtenFiles)
+        directories.emplace_back(file.parent_path());
+    deduplicate(directories);
+#if defined(__linux__)
+    // past a handful of files, one flush of each filesystem beats a flush per file
+    if (writtenFiles.size() > 64) {
+        std::set<dev_t> synced; // the temporary, persistent, and cold directories can each be on a different filesystem
+        for (const auto& directory : directories) {
+            int fd = open(directory.string().data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd == -1) continue;
+            struct stat info {};
+            if (fstat(fd, &info) == 0 && synced.emplace(info.st_dev).second) syncfs(fd);
+            close(fd);
+        }
+        if (!synced.empty()) {
+            writtenFiles.clear();
+            return;
+        }
+    }
+#endif
+#if defined(UNIX_OR_UNIX_LIKE)
+    for (const auto& file : writtenFiles) {
+        if (int fd = open(file.string().data(), O_RDONLY | O_CLOEXEC); fd != -1) {
+            fdatasync(fd);
+            close(fd);
+        }
+    }
+    // new names only survive a crash once the directories holding them are flushed too
+    for (const auto& directory : directories) {
+        if (int fd = open(directory.string().data(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); fd != -1) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+#elif defined(_WIN32) || defined(_WIN64)
+    for (const auto& file : writtenFiles) {
+        HANDLE handle = CreateFileW(file.wstring().data(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (handle == INVALID_HANDLE_VALUE) continue;
+        FlushFileBuffers(handle);
+        CloseHandle(handle);
+    }
+#endif
+    writtenFiles.clear();
+}
+
+bool isRawDataFile(const fs::path& path) {
+    auto name = path.filename().string();
+    if (!name.starts_with(constants.data_file_name)) return false;
+    auto suffix = std::string_view(name).substr(constants.data_file_name.size());
+    return suffix.empty() || suffix == codecExtension(Codec::Zlib) || suffix == codecExtension(Codec::Zstd);
+}
+
+std::pair<fs::path, Codec> storedRawData(const fs::path& raw) {
+    for (const auto& codec : {Codec::Zstd, Codec::Zlib}) {
+        auto compressed = fs::path(raw).concat(codecExtension(codec));
+        if (fs::exists(compressed)) return {compressed, codec};
+    }
+    return {raw, Codec::None};
+}
+
+bool streamRawData(const fs::path& raw, const std::function<bool(const std::string_view&)>& consumer) {
+    auto [file, codec] = storedRawData(raw);
+    if (codec != Codec::None) {
+        decompressFromFile(file, codec, consumer);
+        return true;
+    }
+    if (streamFile(file, consumer)) return true;
+    auto segmented = segmentedRawData(raw);
+    if (!segmented) return false;
+    consumer(segmented->read()); // segmented entries are small by definition
+    return true;
+}
+
+std::optional<std::string> rawDataContents(const fs::path& raw, size_t limit) {
+    if (limit == 0 && storedRawData(raw).second == Codec::None) {
+        if (auto contents = fileContents(raw)) return contents;
+        if (auto segmented = segmentedRawData(raw)) return segmented->read();
+        return std::nullopt;
+    }
+    std::string contents;
+    bool found = streamRawData(raw, [&](const std::string_view& chunk) {
+        contents.append(limit == 0 ? chunk : chunk.substr(0, limit - contents.size()));
+        return limit == 0 || contents.size() < limit;
+    });
+    if (!found) return std::nullopt;
+    return contents;
+}
+
+std::optional<size_t> rawDataSize(const fs::path& raw) {
+    auto [file, codec] = storedRawData(raw);
+    if (codec == Codec::None) {
+        std::error_code ec;
+        auto size = fs::file_size(file, ec);
+        if (!ec) return size;
+        if (auto segmented = segmentedRawData(raw)) return segmented->location.length;
+        return std::nullopt;
+    }
+    return uncompressedLength(file, codec);
+}
+
+size_t writeRawData(const fs::path& raw, const std::string& content, bool append) {
+    // an entry only gets changed in its own directory, so move it out of its segment first
+    if (!fs::exists(raw.parent_path()))
+        if (auto segmented = segmentedRawData(raw)) segmented->store.materialize(segmented->entry, raw.parent_path());
+    auto [file, codec] = storedRawData(raw);
+    if (append && codec != Codec::None) {
+        compressToFile(file, content, codec, true);
+        return content.size();
+    }
+    if (append) return writeToFile(raw, content, true);
+    std::error_code ec;
+    if (codec != Codec::None) fs::remove(file, ec);
+    if (auto wanted = configuredCodec(); wanted != Codec::None && content.size() >= minimum_compressible_size && !isAlreadyCompressed(content)) {
+        fs::remove(raw, ec);
+        compressToFile(fs::path(raw).concat(codecExtension(wanted)), content, wanted);
+        return content.size();
+    }
+    return writeToFile(raw, content);
+}
+
+bool exchangePaths(const fs::path& one, const fs::path& two) {
+#if defined(__linux__) && defined(SYS_renameat2) && defined(RENAME_EXCHANGE)
+    // renameat2 swaps both paths in a single atomic step, but only within one filesystem and only on kernels and filesystems that support it
+    if (syscall(SYS_renameat2, AT_FDCWD, one.string().data(), AT_FDCWD, two.string().data(), RENAME_EXCHANGE) == 0) return true;
+    if (errno != EXDEV && errno != EINVAL && errno != ENOSYS && errno != ENOTSUP) throw fs::filesystem_error("Couldn't exchange paths", one, two, std::error_code(errno, std::generic_category()));
+#endif
+    return false;
+}
+
+void swapPaths(const fs::path& one, const fs::path& two) {
+    if (exchangePaths(one, two)) return;
+
+    // a rename that fails partway has the ones before it undone in reverse order, so both paths are back where they were before copying is tried instead
+    auto swapByRenaming = [&] {
+        auto swapTarget = fs::path(one).replace_extension("swap");
+        std::error_code ec;
+        renamePath(one, swapTarget, ec);
+        if (ec) return false;
+        renamePath(two, one, ec);
+        if (ec) {
+            renamePath(swapTarget, one);
+            return false;
+        }
+        renamePath(swapTarget, two, ec);
+        if (ec) {
+            renamePath(one, two);
+            renamePath(swapTarget, one);
+            return false;
+        }
+        return true;
+    };
+    if (onSameFilesystem(one, two) && swapByRenaming()) return;
+
+    // Copy each side next to the other so that the final step on each filesystem is still a rename, never a half-written directory
+    auto swapTargetOne = fs::path(one).replace_extension("swap");
+    auto swapTargetTwo = fs::path(two).replace_extension("swap");
+    cowCopy(two, swapTargetOne);
+    cowCopy(one, swapTargetTwo);
+    for (const auto& [target, swapTarget] : {std::pair {one, swapTargetOne}, std::pair {two, swapTargetTwo}}) {
+        if (!exchangePaths(swapTarget, target)) {
+            removeRecursively(target);
+            renamePath(swapTarget, target);
+        }
+        removeRecursively(swapTarget);
+    }
+}
+
+bool onSameFilesystem(const fs::path& one, const fs::path& two) {
+#if defined(UNIX_OR_UNIX_LIKE)
+    struct stat oneInfo, twoInfo;
+    if (stat(one.string().data(), &oneInfo) != 0 || stat(two.string().data(), &twoInfo) != 0) return false;
+    return oneInfo.st_dev == twoInfo.st_dev;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,183 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+// a directory's descriptor stays open for as long as a lookup still needs it, even once its statuses have been forgotten
+struct Descriptor {
+    int fd = -1;
+    ~Descriptor() {
+#if defined(UNIX_OR_UNIX_LIKE)
+        if (fd != -1) close(fd);
+#endif
+    }
+};
+
+// each directory is opened once, after which every name in it is looked up relative to that descriptor instead of walking the whole path again
+struct DirectoryStatuses {
+    std::shared_ptr<Descriptor> descriptor;
+    std::unordered_map<std::string, FileStatus> names;
+};
+
+std::mutex statusesMutex;
+std::map<fs::path, DirectoryStatuses> statuses;
+uint64_t generation = 0; // goes up whenever something is forgotten, so a lookup that raced a change doesn't put back what it saw before
+constexpr size_t maximum_open_directories = 64;
+
+#if defined(__linux__)
+FileStatus statusFromStatx(const struct statx& info) {
+    FileStatus status;
+    status.exists = true;
+    status.is_directory = S_ISDIR(info.stx_mode);
+    status.is_regular_file = S_ISREG(info.stx_mode);
+    status.size = info.stx_size;
+    auto since_epoch = std::chrono::seconds(info.stx_mtime.tv_sec) + std::chrono::nanoseconds(info.stx_mtime.tv_nsec);
+    status.write_time =
+            std::chrono::time_point_cast<fs::file_time_type::duration>(std::chrono::file_clock::from_sys(std::chrono::sys_time<std::chrono::nanoseconds>(since_epoch)));
+    return status;
+}
+#endif
+
+FileStatus fetchStatus(const Descriptor* directory, const fs::path& file) {
+#if defined(__linux__)
+    // only ask for what the callers use, which lets network and FUSE filesystems skip fetching the rest
+    struct statx info;
+    constexpr unsigned int mask = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+    auto name = file.filename().string();
+    if (directory && directory->fd != -1 ? statx(directory->fd, name.data(), 0, mask, &info) == 0 : statx(AT_FDCWD, file.string().data(), 0, mask, &info) == 0)
+        return statusFromStatx(info);
+    return {};
+#else
+    FileStatus status;
+    std::error_code ec;
+    auto type = fs::status(file, ec).type();
+    if (ec || type == fs::file_type::not_found) return status;
+    status.exists = true;
+    status.is_directory = type == fs::file_type::directory;
+    status.is_regular_file = type == fs::file_type::regular;
+    if (status.is_regular_file) status.size = fs::file_size(file, ec);
+    status.write_time = fs::last_write_time(file, ec);
+    return status;
+#endif
+}
+
+void forgetUnlocked(const fs::path& file) {
+    generation++;
+    if (auto directory = statuses.find(file.parent_path()); directory != statuses.end()) directory->second.names.erase(file.filename().string());
+    // a directory that changed could have changed anything under it too, and its descriptor might now point somewhere else
+    for (auto directory = statuses.lower_bound(file); directory != statuses.end();) {
+        if (std::mismatch(file.begin(), file.end(), directory->first.begin(), directory->first.end()).first != file.end()) break;
+        directory = statuses.erase(directory);
+    }
+}
+
+} // namespace
+
+FileStatus cachedStatus(const fs::path& file) {
+    auto parent = file.parent_path();
+    auto name = file.filename().string();
+    // paths like "dir/" or "." have no name of their own to look up in their parent
+    if (name.empty() || name == "." || name == "..") {
+        parent = file;
+        name = ".";
+    }
+    std::shared_ptr<Descriptor> descriptor;
+    bool openDirectory = false;
+    uint64_t seen;
+    {
+        std::lock_guard<std::mutex> lock(statusesMutex);
+        auto& directory = statuses[parent];
+        if (auto cached = directory.names.find(name); cached != directory.names.end()) return cached->second;
+        descriptor = directory.descriptor;
+#if defined(__linux__)
+        openDirectory = !descriptor && directory.names.empty() && statuses.size() <= maximum_open_directories;
+#endif
+        seen = generation;
+    }
+    // the syscalls happen without holding the lock, so threads looking up different paths don't wait on each other
+#if defined(__linux__)
+    if (openDirectory) {
+        descriptor = std::make_shared<Descriptor>();
+        descriptor->fd = open(parent.empty() ? "." : parent.string().data(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+#endif
+    auto status = fetchStatus(descriptor.get(), name == "." ? parent / "." : file);
+    std::lock_guard<std::mutex> lock(statusesMutex);
+    if (generation != seen) return status;
+    auto& directory = statuses[parent];
+    if (openDirectory && !directory.descriptor) directory.descriptor = descriptor;
+    directory.names.emplace(name, status);
+    return status;
+}
+
+void forgetCachedStatus(const fs::path& file) {
+    std::lock_guard<std::mutex> lock(statusesMutex);
+    forgetUnlocked(file);
+}
+
+void forgetCachedStatuses() {
+    std::lock_guard<std::mutex> lock(statusesMutex);
+    generation++;
+    statuses.clear();
+}
+
+void renamePath(const fs::path& from, const fs::path& to) {
+    fs::rename(from, to);
+    forgetCachedStatus(from);
+    forgetCachedStatus(to);
+}
+
+void renamePath(const fs::path& from, const fs::path& to, std::error_code& ec) {
+    fs::rename(from, to, ec);
+    forgetCachedStatus(from);
+    forgetCachedStatus(to);
+}
+
+std::uintmax_t removeRecursively(const fs::path& path) {
+    auto removed = fs::remove_all(path);
+    forgetCachedStatus(path);
+    return removed;
+}
+
+std::uintmax_t removeRecursively(const fs::path& path, std::error_code& ec) {
+    auto removed = fs::remove_all(path, ec);
+    forgetCachedStatus(path);
+    return removed;
+}
+
+bool createDirectories(const fs::path& path) {
+    std::error_code ec;
+    auto created = createDirectories(path, ec);
+    if (ec) throw fs::filesystem_error("Couldn't create directories", path, ec);
+    return created;
+}
+
+bool createDirectories(const fs::path& path, std::error_code& ec) {
+    auto created = fs::create_directories(path, ec);
+    if (!created) return false;
+    // any of the levels above it could be new too
+    std::lock_guard<std::mutex> lock(statusesMutex);
+    forgetUnlocked(path);
+    for (auto level = path.parent_path(); !level.empty() && level != level.parent_path(); level = level.parent_path())
+        if (auto directory = statuses.find(level.parent_path()); directory != statuses.end()) directory->second.names.erase(level.filename().string());
+    return true;
+}
@@ -0,0 +1,232 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+#include <utility>
+
+namespace {
+
+// every change and every undo or redo is one of these appended to the journal, so a reader replays them to find where the undo cursor is
+enum class Operation : uint64_t {
+    Created = 1, // a copy or clear made a new entry, which undoing hides
+    CreatedByCut = 2,
+    Changed = 3, // an entry was changed in place, and the snapshot holds the other version of it
+    Undone = 4,
+    Redone = 5,
+    Swapped = 6 // the entry traded places with one in another clipboard, whose journal has the same step and the same snapshot number
+};
+
+struct JournalRecord {
+    uint64_t operation;
+    uint64_t entry;
+    uint64_t snapshot;
+    int64_t time;
+};
+static_assert(sizeof(JournalRecord) == 32);
+
+struct Journal {
+    std::vector<JournalRecord> steps;
+    size_t cursor = 0;                                   // steps before this are done, the rest were undone and could be redone
+    std::vector<std::pair<JournalRecord, bool>> dropped; // steps that can't be undone or redone anymore, and whether they were undone at the time
+    size_t records = 0;
+};
+
+constexpr size_t undo_steps = 16;
+
+Journal replayedJournal(const fs::path& file) {
+    Journal journal;
+    auto contents = fileContents(file);
+    if (!contents) return journal;
+    // a torn record at the end from an interrupted append is simply ignored
+    for (size_t offset = 0; offset + sizeof(JournalRecord) <= contents->size(); offset += sizeof(JournalRecord)) {
+        JournalRecord record;
+        std::memcpy(&record, contents->data() + offset, sizeof(JournalRecord));
+        journal.records++;
+        switch (static_cast<Operation>(record.operation)) {
+        case Operation::Created:
+        case Operation::CreatedByCut:
+        case Operation::Changed:
+        case Operation::Swapped:
+            // a new change means whatever was undone can't come back anymore
+            for (auto step = journal.steps.begin() + journal.cursor; step != journal.steps.end(); step++)
+                journal.dropped.emplace_back(*step, true);
+            journal.steps.resize(journal.cursor);
+            journal.steps.emplace_back(record);
+            if (journal.steps.size() > undo_steps) {
+                journal.dropped.emplace_back(journal.steps.front(), false);
+                journal.steps.erase(journal.steps.begin());
+            }
+            journal.cursor = journal.steps.size();
+            break;
+        case Operation::Undone:
+            if (journal.cursor > 0) journal.cursor--;
+            break;
+        case Operation::Redone:
+            if (journal.cursor < journal.steps.size()) journal.cursor++;
+            break;
+        }
+    }
+    return journal;
+}
+
+bool isCreation(const JournalRecord& record) {
+    return record.operation == static_cast<uint64_t>(Operation::Created) || record.operation == static_cast<uint64_t>(Operation::CreatedByCut);
+}
+
+} // namespace
+
+fs::path Clipboard::undoPathFor(const unsigned long& entry, const uint64_t& snapshot) {
+    // next to the entry itself so undoing and redoing are always renames within one directory
+    auto name = "." + std::to_string(entry) + "-" + std::to_string(snapshot) + std::string(constants.undo_extension);
+    auto beside = entryDirectoryFor(entry).parent_path() / name;
+    // an undone entry isn't indexed anymore, so it could have been hidden in the cold tier without this clipboard knowing
+    if (!cold_root.empty() && !fs::exists(beside))
+        if (auto cold = coldEntryDirectoryFor(entry).parent_path() / name; fs::exists(cold)) return cold;
+    return beside;
+}
+
+void Clipboard::appendJournalRecord(const uint64_t& operation, const unsigned long& entry, const uint64_t& snapshot) {
+    JournalRecord record {operation, entry, snapshot, std::chrono::system_clock::now().time_since_epoch().count()};
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen((metadata / constants.journal_name).string().data(), "ab"), &std::fclose);
+    if (!file || std::fwrite(&record, sizeof(JournalRecord), 1, file.get()) != 1)
+        throw fs::filesystem_error("Couldn't update the journal", metadata / constants.journal_name, std::error_code(errno, std::generic_category()));
+    recordWrittenFile(metadata / constants.journal_name);
+}
+
+void Clipboard::journalNewEntry() {
+    if (entryIndex.empty() || !fs::exists(entryDirectoryFor(entryIndex.front()))) return;
+    appendJournalRecord(static_cast<uint64_t>(action == Action::Cut ? Operation::CreatedByCut : Operation::Created), entryIndex.front(), 0);
+}
+
+void Clipboard::keepForUndo(const unsigned long& entry, const fs::path& previous) {
+    // the version an entry change replaced becomes the snapshot as it is, so keeping it costs a rename rather than a copy
+    auto snapshot = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    renamePath(previous, undoPathFor(entry, snapshot));
+    appendJournalRecord(static_cast<uint64_t>(Operation::Changed), entry, snapshot);
+}
+
+void Clipboard::journalSwapWith(Clipboard& other) {
+    // one step in each journal, so undoing or redoing the swap from either clipboard puts both back together
+    auto snapshot = static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    writeToFile(undoPathFor(entryNumberAt(this_entry), snapshot), other.name());
+    writeToFile(other.undoPathFor(other.entryNumberAt(other.this_entry), snapshot), this_name);
+    appendJournalRecord(static_cast<uint64_t>(Operation::Swapped), entryNumberAt(this_entry), snapshot);
+    other.appendJournalRecord(static_cast<uint64_t>(Operation::Swapped), other.entryNumberAt(other.this_entry), snapshot);
+}
+
+bool Clipboard::stepJournal(const bool& forward) {
+    auto journal = replayedJournal(metadata / constants.journal_name);
+    if (forward ? journal.cursor == journal.steps.size() : journal.cursor == 0) return false;
+    const auto step = journal.steps.at(forward ? journal.cursor : journal.cursor - 1);
+
+    auto entryDirectory = entryDirectoryFor(step.entry);
+    auto hidden = undoPathFor(step.entry, step.snapshot);
+    if (!fs::exists(entryDirectory)) segmentsHolding(step.entry).materialize(step.entry, entryDirectory);
+    std::error_code ec;
+    // an empty entry in the way of a redo is just the one a clipboard gets when its only entry was undone
+    bool possible = isCreation(step) && forward ? fs::exists(hidden) && (!fs::exists(entryDirectory) || fs::is_empty(entryDirectory, ec))
+                                                : fs::exists(entryDirectory) && (isCreation(step) || fs::exists(hidden));
+    // otherwise the entry was trimmed from the history since, so there's nothing left to step back or forward to
+    if (!possible)
+        throw fs::filesystem_error("The entry isn't in the history anymore", entryDirectory, std::make_error_code(std::errc::no_such_file_or_directory));
+
+    if (isCreation(step)) {
+        // undoing a copy hides its entry under a name the entry index skips, and redoing brings it back
+        auto restored = hidden.parent_path() / std::to_string(step.entry);
+        if (forward)
+            renamePath(hidden, restored);
+        else
+            renamePath(entryDirectory, hidden);
+        if (step.operation == static_cast<uint64_t>(Operation::CreatedByCut)) {
+            // an undone cut mustn't remove the originals on the next paste
+            auto pending = fs::path(metadata.originals).concat(constants.undo_extension);
+            renamePath(forward ? pending : metadata.originals, forward ? metadata.originals : pending, ec);
+            // and items it moved into the entry go back where they came from, unless something else is there now
+            auto pendingMoves = fs::path(metadata.moved).concat(constants.undo_extension);
+            auto fromList = forward ? pendingMoves : fs::path(metadata.moved), toList = forward ? fs::path(metadata.moved) : pendingMoves;
+            auto remaining = movedItemsIn(fromList), transferred = movedItemsIn(toList);
+            for (const auto& item : remaining) {
+                if (item.first != step.entry) continue;
+                auto inEntry = (forward ? restored : hidden) / item.second.filename();
+                auto [from, to] = forward ? std::pair {item.second, inEntry} : std::pair {inEntry, item.second};
+                if (!fs::exists(to, ec)) renamePath(from, to, ec);
+                transferred.emplace_back(item);
+            }
+            std::erase_if(remaining, [&](const auto& item) { return item.first == step.entry; });
+            saveMovedItems(fromList, remaining);
+            saveMovedItems(toList, transferred);
+        }
+    } else if (step.operation == static_cast<uint64_t>(Operation::Swapped)) {
+        // the snapshot names the other clipboard, and its journal has to be at the same swap for both sides to step together
+        auto otherName = fileContents(hidden).value_or("");
+        if (otherName.empty()) throw fs::filesystem_error("The swap doesn't say which clipboard it was with", hidden, std::make_error_code(std::errc::no_such_file_or_directory));
+        Clipboard other(otherName);
+        auto otherJournal = replayedJournal(other.metadata / constants.journal_name);
+        bool atSwap = forward ? otherJournal.cursor < otherJournal.steps.size() : otherJournal.cursor > 0;
+        auto otherStep = atSwap ? otherJournal.steps.at(forward ? otherJournal.cursor : otherJournal.cursor - 1) : JournalRecord {};
+        if (otherStep.operation != static_cast<uint64_t>(Operation::Swapped) || otherStep.snapshot != step.snapshot)
+            throw fs::filesystem_error("The other clipboard changed since the swap", other.metadata / constants.journal_name, std::make_error_code(std::errc::operation_not_permitted));
+        auto otherDirectory = other.entryDirectoryFor(otherStep.entry);
+        if (!fs::exists(otherDirectory)) other.segmentsHolding(otherStep.entry).materialize(otherStep.entry, otherDirectory);
+        swapPaths(entryDirectory, otherDirectory);
+        other.appendJournalRecord(static_cast<uint64_t>(forward ? Operation::Redone : Operation::Undone), otherStep.entry, otherStep.snapshot);
+        Clipboard(otherName).markContentChanged(true);
+    } else
+        swapPaths(entryDirectory, hidden); // the snapshot always holds whichever version isn't showing
+
+    appendJournalRecord(static_cast<uint64_t>(forward ? Operation::Redone : Operation::Undone), step.entry, step.snapshot);
+
+    auto holdsLock = std::exchange(holds_lock, false);
+    *this = Clipboard(this_name, this_entry);
+    holds_lock = holdsLock;
+    // the step can bring back a version of any entry, not just the current one
+    markContentChanged(true);
+    return true;
+}
+
+bool Clipboard::undo() {
+    return stepJournal(false);
+}
+
+bool Clipboard::redo() {
+    return stepJournal(true);
+}
+
+void Clipboard::compactJournal() {
+    if (!holds_lock) return;
+    auto file = metadata / constants.journal_name;
+    auto journal = replayedJournal(file);
+    if (journal.dropped.empty() && journal.records <= journal.steps.size() * 2 + 16) return;
+
+    std::error_code ec;
+    for (const auto& [step, undone] : journal.dropped) {
+        // a changed entry's snapshot is never needed again, while a new entry only goes away if it was undone
+        if (isCreation(step) && !undone) continue;
+        removeRecursively(undoPathFor(step.entry, step.snapshot), ec);
+        if (step.operation == static_cast<uint64_t>(Operation::CreatedByCut)) {
+            fs::remove(fs::path(metadata.originals).concat(constants.undo_extension), ec);
+            fs::remove(fs::path(metadata.moved).concat(constants.undo_extension), ec);
+        }
+    }
+
+    std::string compacted;
+    for (const auto& step : journal.steps)
+        compacted.append(reinterpret_cast<const char*>(&step), sizeof(JournalRecord));
+    for (auto step = journal.steps.size(); step > journal.cursor; step--) {
+        JournalRecord undone {static_cast<uint64_t>(Operation::Undone), 0, 0, 0};
+        compacted.append(reinterpret_cast<const char*>(&undone), sizeof(JournalRecord));
+    }
+    writeToFile(file, compacted);
+}
@@ -0,0 +1,119 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+
+namespace {
+
+// a manifest is the signature followed by fields of [u8 tag][u32 length][bytes], all integers little endian; readers skip tags they don't know about
+enum class Field : uint8_t {
+    Version = 1,
+    Notes = 2,
+    Ignore = 3,
+    IgnoreSecret = 4,
+    ScriptConfig = 5,
+    HasScript = 6, // no longer written, since whether there's a script is only up to the script file itself
+    Totals = 7,
+    Sharded = 8
+};
+
+void appendInteger(std::string& output, const uint64_t& value, const size_t& bytes) {
+    for (size_t i = 0; i < bytes; i++)
+        output.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+uint64_t readInteger(const std::string_view& input, const size_t& bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++)
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(input[i])) << (i * 8);
+    return value;
+}
+
+void appendField(std::string& output, const Field& tag, const std::string_view& content) {
+    output.push_back(static_cast<char>(tag));
+    appendInteger(output, content.size(), 4);
+    output.append(content);
+}
+
+} // namespace
+
+std::optional<Manifest> Manifest::load(const fs::path& file) {
+    auto contents = fileContents(file);
+    if (!contents || !contents->starts_with(constants.manifest_signature)) return std::nullopt;
+    std::string_view input(*contents);
+    input.remove_prefix(constants.manifest_signature.size());
+
+    Manifest manifest;
+    while (input.size() >= 5) {
+        auto tag = static_cast<Field>(input[0]);
+        auto length = readInteger(input.substr(1), 4);
+        input.remove_prefix(5);
+        if (length > input.size()) return std::nullopt;
+        auto content = input.substr(0, length);
+        input.remove_prefix(length);
+        switch (tag) {
+        case Field::Version:
+            manifest.version = content;
+            break;
+        case Field::Notes:
+            manifest.notes = content;
+            break;
+        case Field::Ignore:
+            manifest.ignore = content;
+            break;
+        case Field::IgnoreSecret:
+            manifest.ignore_secret = content;
+            break;
+        case Field::ScriptConfig:
+            manifest.script_config = content;
+            break;
+        case Field::Sharded:
+            manifest.sharded = !content.empty() && content[0] != 0;
+            break;
+        case Field::Totals:
+            if (content.size() == 16) manifest.totals = Totals {readInteger(content, 8), readInteger(content.substr(8), 8)};
+            break;
+        default:
+            break;
+        }
+    }
+    return manifest;
+}
+
+void Manifest::save(const fs::path& file) const {
+    std::string output(constants.manifest_signature);
+    appendField(output, Field::Version, constants.storage_protocol_version);
+    if (notes) appendField(output, Field::Notes, *notes);
+    if (ignore) appendField(output, Field::Ignore, *ignore);
+    if (ignore_secret) appendField(output, Field::IgnoreSecret, *ignore_secret);
+    if (script_config) appendField(output, Field::ScriptConfig, *script_config);
+    if (sharded) appendField(output, Field::Sharded, std::string_view("\x01", 1));
+    if (totals) {
+        std::string content;
+        appendInteger(content, totals->entries, 8);
+        appendInteger(content, totals->bytes, 8);
+        appendField(output, Field::Totals, content);
+    }
+
+    writeToFile(file, output); // readers never see a half-written manifest because writes only replace a file once they're complete
+}
+
+void discardCachedTotals(const fs::path& clipboardRoot) {
+    auto file = clipboardRoot / constants.metadata_directory / constants.manifest_name;
+    auto manifest = Manifest::load(file);
+    if (!manifest || !manifest->totals) return;
+    manifest->totals.reset();
+    manifest->save(file);
+}
@@ -0,0 +1,224 @@
+/*  The Clipboard Project - Cut, copy, and paste anything, anytime, anywhere, all from the terminal.
+    Copyright (C) 2023 Jackson Huff and other contributors on GitHub.com
+    SPDX-License-Identifier: GPL-3.0-or-later
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.*/
+#include "../clipboard.hpp"
+#include <charconv>
+#include <map>
+
+namespace {
+
+// every change to a segment store is one of these appended to the index, so a reader replays them in order to find where each entry lives
+struct IndexRecord {
+    uint64_t entry;
+    uint64_t segment;
+    uint64_t offset;
+    uint64_t length;
+    int64_t mtime;
+};
+static_assert(sizeof(IndexRecord) == 40);
+
+constexpr uint64_t tombstone = UINT64_MAX;
+constexpr size_t maximum_segment_size = 4 * 1024 * 1024;
+constexpr size_t minimum_wasted_bytes = 64 * 1024;
+
+} // namespace
+
+SegmentStore::SegmentStore(const fs::path& clipboardRoot) : directory(clipboardRoot / constants.segments_directory) {
+    auto contents = fileContents(directory / constants.segment_index_name);
+    if (!contents) return;
+    // a torn record at the end from an interrupted append is simply ignored
+    for (size_t offset = 0; offset + sizeof(IndexRecord) <= contents->size(); offset += sizeof(IndexRecord)) {
+        IndexRecord record;
+        std::memcpy(&record, contents->data() + offset, sizeof(IndexRecord));
+        apply(record.entry, record.length == tombstone ? std::nullopt : std::optional<Location>({record.segment, record.offset, record.length, record.mtime}));
+    }
+}
+
+SegmentStore::~SegmentStore() {
+    closeSegments();
+}
+
+void SegmentStore::apply(const unsigned long& entry, const std::optional<Location>& location) {
+    if (auto existing = index.find(entry); existing != index.end()) {
+        liveBytes -= existing->second.length;
+        wastedBytes += existing->second.length;
+        index.erase(existing);
+    }
+    if (!location) return;
+    index.emplace(entry, location.value());
+    liveBytes += location->length;
+    currentSegment = std::max(currentSegment, location->segment);
+}
+
+fs::path SegmentStore::segmentPath(const uint64_t& segment) const {
+    return directory / (std::to_string(segment) + std::string(constants.segment_extension));
+}
+
+void SegmentStore::appendRecord(const unsigned long& entry, const std::optional<Location>& location) {
+    IndexRecord record {entry, 0, 0, tombstone, 0};
+    if (location) record = {entry, location->segment, location->offset, location->length, location->mtime};
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen((directory / constants.segment_index_name).string().data(), "ab"), &std::fclose);
+    if (!file || std::fwrite(&record, sizeof(IndexRecord), 1, file.get()) != 1)
+        throw fs::filesystem_error("Couldn't update the segment index", directory, std::error_code(errno, std::generic_category()));
+    recordWrittenFile(directory / constants.segment_index_name);
+    apply(entry, location);
+}
+
+std::optional<SegmentStore::Location> SegmentStore::find(const unsigned long& entry) const {
+    if (auto location = index.find(entry); location != index.end()) return location->second;
+    return std::nullopt;
+}
+
+std::vector<unsigned long> SegmentStore::entries() const {
+    std::vector<unsigned long> entries;
+    entries.reserve(index.size());
+    for (const auto& [entry, location] : index)
+        entries.emplace_back(entry);
+    return entries;
+}
+
+std::string SegmentStore::read(const Location& location) {
+    std::lock_guard<std::mutex> lock(readMutex);
+    auto& file = openSegments[location.segment];
+    if (!file) file = std::fopen(segmentPath(location.segment).string().data(), "rb");
+    if (!file) throw fs::filesystem_error("Couldn't open segment", segmentPath(location.segment), std::error_code(errno, std::generic_category()));
+    std::string content(location.length, '\0');
+    if (std::fseek(file, static_cast<long>(location.offset), SEEK_SET) != 0 || std::fread(content.data(), 1, content.size(), file) != content.size())
+        throw fs::filesystem_error("Couldn't read segment", segmentPath(location.segment), std::error_code(errno, std::generic_category()));
+    return content;
+}
+
+void SegmentStore::append(const unsigned long& entry, const std::string_view& content, const fs::file_time_type& writeTime) {
+    createDirectories(directory);
+    std::error_code ec;
+    auto size = fs::file_size(segmentPath(currentSegment), ec);
+    if (ec) size = 0;
+    if (size > 0 && size + content.size() > maximum_segment_size) {
+        currentSegment++;
+        size = 0;
+    }
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> file(std::fopen(segmentPath(currentSegment).string().data(), "ab"), &std::fclose);
+    if (!file || std::fwrite(content.data(), 1, content.size(), file.get()) != content.size())
+        throw fs::filesystem_error("Couldn't append to segment", segmentPath(currentSegment), std::error_code(errno, std::generic_category()));
+    file.reset();
+    recordWrittenFile(segmentPath(currentSegment));
+    // the index only points at the data once the data is completely written
+    appendRecord(entry, Location {currentSegment, size, content.size(), writeTime.time_since_epoch().count()});
+}
+
+void SegmentStore::erase(const unsigned long& entry) {
+    if (index.contains(entry)) appendRecord(entry, std::nullopt);
+}
+
+void SegmentStore::materialize(const unsigned long& entry, const fs::path& entryDirectory) {
+    auto location = find(entry);
+    if (!location) return;
+    createDirectories(entryDirectory);
+    auto raw = entryDirectory / constants.data_file_name;
+    writeToFile(raw, read(location.value()));
+    fs::last_write_time(raw, location->writeTime());
+    fs::last_write_time(entryDirectory, location->writeTime());
+    erase(entry);
+}
+
+void SegmentStore::closeSegments() {
+    for (auto& [segment, file] : openSegments)
+        if (file) std::fclose(file);
+    openSegments.clear();
+}
+
+void SegmentStore::compact() {
+    if (wastedBytes < minimum_wasted_bytes || wastedBytes < liveBytes) return;
+
+    // rewrite only the live entries, oldest first so history and search keep reading the segments front to back
+    auto lastOldSegment = currentSegment;
+    std::map<unsigned long, Location> compacted;
+    std::string newIndex;
+    uint64_t segment = currentSegment + 1;
+    uint64_t size = 0;
+    std::unique_ptr<std::FILE, decltype(&std::fclose)> output(nullptr, &std::fclose);
+    for (const auto& [entry, location] : index) {
+        auto content = read(location);
+        if (!output || (size > 0 && size + content.size() > maximum_segment_size)) {
+            if (output) segment++;
+            size = 0;
+            output.reset(std::fopen(segmentPath(segment).string().data(), "wb"));
+            if (!output) throw fs::filesystem_error("Couldn't create segment", segmentPath(segment), std::error_code(errno, std::generic_category()));
+        }
+        if (std::fwrite(content.data(), 1, content.size(), output.get()) != content.size())
+            throw fs::filesystem_error("Couldn't write segment", segmentPath(segment), std::error_code(errno, std::generic_category()));
+        recordWrittenFile(segmentPath(segment));
+        Location moved {segment, size, location.length, location.mtime};
+        IndexRecord record {entry, moved.segment, moved.offset, moved.length, moved.mtime};
+        newIndex.append(reinterpret_cast<const char*>(&record), sizeof(IndexRecord));
+        compacted.emplace(entry, moved);
+        size += content.size();
+    }
+    output.reset();
+    closeSegments();
+
+    writeToFile(directory / constants.segment_index_name, newIndex);
+
+    for (const auto& file : fs::directory_iterator(directory)) {
+        if (file.path().extension() != constants.segment_extension) continue;
+        uint64_t old;
+        auto name = file.path().stem().string();
+        if (auto [ptr, ec] = std::from_chars(name.data(), name.data() + name.size(), old); ec == std::errc() && old <= lastOldSegment) fs::remove(file.path());
+    }
+
+    index = std::move(compacted);
+    wastedBytes = 0;
+    currentSegment = index.empty() ? 0 : segment;
+}
+
+SegmentStore& segmentsFor(const fs::path& clipboardRoot) {
+    static std::mutex storesMutex;
+    static std::map<fs::path, std::unique_ptr<SegmentStore>> stores;
+    std::lock_guard<std::mutex> lock(storesMutex);
+    auto& store = stores[clipboardRoot];
+    if (!store) store = std::make_unique<SegmentStore>(clipboardRoot);
+    return *store;
+}
+
+std::optional<SegmentedEntry> segmentedRawData(const fs::path& raw) {
+    // raw data paths look like <clipboard>/data/<entry>/rawdata.clipboard even when the entry itself lives in a segment
+    auto entryDirectory = raw.parent_path();
+    auto entries = entryDirectory.parent_path();
+    if (entries.extension() == constants.shard_extension) entries = entries.parent_path();
+    if (entries.filename() != constants.data_directory) return std::nullopt;
+    auto name = entryDirectory.filename().string();
+    unsigned long entry;
+    if (auto [ptr, ec] = std::from_chars(name.data(), name.data() + name.size(), entry); ec != std::errc() || ptr != name.data() + name.size()) return std::nullopt;
+    auto& store = segmentsFor(entries.parent_path());
+    if (auto location = store.find(entry)) return SegmentedEntry {store, entry, location.value()};
+    return std::nullopt;
+}
+
+size_t segmentThreshold() {
+    static auto threshold = [] {
+        size_t bytes = 4096;
+        if (auto setting = getenv("CLIPBOARD_SEGMENT_THRESHOLD")) {
+            std::string_view value(setting);
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), bytes);
+            if (ec != std::errc()) return static_cast<size_t>(4096);
+            std::string unit(ptr, value.data() + value.size());
+            std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+            if (unit == "kb") bytes *= 1024;
+            if (unit == "mb") bytes *= 1024 * 1024;
+        }
+        return bytes;
+    }();
+    return threshold;
+}
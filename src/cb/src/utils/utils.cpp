@@ -29,7 +29,6 @@
 #include <iterator>
 #include <locale>
 #include <mutex>
-#include <openssl/sha.h>
 #include <optional>
 #include <regex>
 #include <sstream>
@@ -50,6 +49,9 @@ Copying copying;
 bool output_silent = false;
 bool progress_silent = false;
 bool confirmation_silent = false;
+bool tee_output = false;
+bool archive_mode = false;
+bool follow_output = false;
 bool no_color = false;
 bool all_option = false;
 bool secret_selection = false;
@@ -57,6 +59,7 @@ bool secret_selection = false;
 std::string maximumHistorySize;
 
 std::string preferred_mime;
+std::string pack_file;
 std::vector<std::string> available_mimes;
 std::vector<std::string> script_actions;
 std::vector<std::string> script_timings;
@@ -116,7 +119,7 @@ std::vector<std::string> regexSplit(const std::string& content, const std::regex
     return std::vector<std::string>(begin, end);
 }
 
-std::string pipedInContent(bool count) {
+std::string pipedInContent(bool count, bool tee) {
     std::string content;
 #if !defined(_WIN32) && !defined(_WIN64)
     int len = -1;
@@ -127,6 +130,9 @@ std::string pipedInContent(bool count) {
         len = read(stdinFd, buffer.data(), bufferSize);
         content.append(buffer.data(), len);
         if (count) successes.bytes += len;
+        // passing each chunk along as it comes keeps whatever reads from us going while we're still reading
+        for (ssize_t written = 0, total = 0; tee && total < len; total += written)
+            if ((written = write(fileno(stdout), buffer.data() + total, len - total)) < 0) tee = false; // the reader went away, but the content still gets stored
     }
 #elif defined(_WIN32) || defined(_WIN64)
     HANDLE hStdin = GetStdHandle(STD_INPUT_HANDLE);
@@ -139,6 +145,7 @@ std::string pipedInContent(bool count) {
         if (!bSuccess || dwRead == 0) break;
         content.append(chBuf, dwRead);
         if (count) successes.bytes += dwRead;
+        if (tee) fwrite(chBuf, sizeof(char), dwRead, stdout);
     }
 #endif
     return content;
@@ -165,25 +172,9 @@ unsigned long numberLength(const unsigned long& number) {
 
 void ignoreItemsPreemptively(std::vector<fs::path>& items) {
     if (copying.items.empty() || action == Action::Ignore || io_type == IOType::Pipe) return;
-    if (path.holdsIgnoreRegexes()) {
-        auto regexes = path.ignoreRegexes();
-        for (const auto& regex : regexes)
-            for (const auto& item : items)
-                if (std::regex_match(item.string(), regex)) items.erase(std::find(items.begin(), items.end(), item));
-    }
-    if (path.holdsIgnoreSecrets()) {
-        auto secrets = path.ignoreSecrets();
-        std::array<unsigned char, SHA512_DIGEST_LENGTH> hash;
-        for (const auto& secret : secrets) {
-            for (const auto& item : items) {
-                SHA512(reinterpret_cast<const unsigned char*>(item.string().data()), item.string().size(), hash.data());
-                std::stringstream ss;
-                for (const auto& byte : hash)
-                    ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
-                if (ss.str() == secret) items.erase(std::find(items.begin(), items.end(), item));
-            }
-        }
-    }
+    const auto& rules = path.ignoreRules();
+    if (rules.empty()) return;
+    std::erase_if(items, [&](const auto& item) { return rules.ignores(item.string()) || rules.isSecret(item.string()); });
 }
 
 bool userIsARobot() {
@@ -195,6 +186,11 @@ bool isAWriteAction() {
     return action_is_one_of(Cut, Copy, Add, Clear, Remove, Swap, Load, Import, Edit);
 }
 
+bool isAReadOnlyAction() {
+    using enum Action;
+    return action_is_one_of(Paste, Show, Status, Info, Export, Search, Share, Config) || (action == History && copying.items.empty());
+}
+
 bool isAClearingAction() {
     using enum Action;
     return action_is_one_of(Copy, Cut, Clear);
@@ -231,19 +227,12 @@ bool needsANewEntry() {
 
 void setupHandlers() {
     atexit([] {
+        path.discardStagedEntry(); // only reached when the action didn't finish
+        syncWrittenFiles();
         path.releaseLock();
         stopIndicator(true);
 #if defined(_WIN64) || defined(_WIN32)
         SetConsoleOutputCP(old_code_page);
-        if (isAWriteAction()) {
-            FlushFileBuffers(CreateFileA(global_path.temporary.string().data(), GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
-            FlushFileBuffers(CreateFileA(global_path.persistent.string().data(), GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL));
-        }
-#elif defined(UNIX_OR_UNIX_LIKE)
-        if (isAWriteAction()) {
-            fsync(open(global_path.temporary.string().data(), O_RDONLY));
-            fsync(open(global_path.persistent.string().data(), O_RDONLY));
-        }
 #endif
     });
 
@@ -253,6 +242,7 @@ void setupHandlers() {
             // Indicator thread is not currently running. TODO: Write an unbuffered newline, and maybe a cancellation
             // message, directly to standard error. Note: There is no standard C++ interface for this, so this requires
             // an OS call.
+            path.discardStagedEntry();
             path.releaseLock();
             _exit(EXIT_FAILURE);
         } else {
@@ -453,9 +443,9 @@ IOType getIOType() {
     using enum Action;
     using enum IOType;
     if (action_is_one_of(Cut, Copy, Add, Script)) {
-        if (copying.items.size() >= 1 && std::all_of(copying.items.begin(), copying.items.end(), [](const auto& item) { return !fs::exists(item); })) return Text;
+        if (copying.items.size() >= 1 && std::all_of(copying.items.begin(), copying.items.end(), [](const auto& item) { return !cachedStatus(item).exists; })) return Text;
         if (!is_tty.in && copying.items.empty()) return Pipe;
-    } else if (action_is_one_of(Paste, Show, Clear, Edit, Status, Info, History, Search, Config, Share)) {
+    } else if (action_is_one_of(Paste, Show, Clear, Edit, Status, Info, History, Search, Config, Share, Undo, Redo)) {
         if (!is_tty.out) return Pipe;
         return Text;
     } else if (action_is_one_of(Remove, Note, Ignore, Swap, Load, Import, Export)) {
@@ -470,10 +460,19 @@ void setFlags() {
     if (flagIsPresent<bool>("--fast-copy") || flagIsPresent<bool>("-fc")) copying.use_safe_copy = false;
     if (auto flag = flagIsPresent<std::string>("--mime"); flag != "") preferred_mime = flag;
     if (auto flag = flagIsPresent<std::string>("-m"); flag != "") preferred_mime = flag;
+    if (auto flag = flagIsPresent<std::string>("--pack"); flag != "") pack_file = flag;
     if (auto flag = flagIsPresent<std::string>("--actions"); flag != "") script_actions = regexSplit(flag, std::regex(","));
     if (auto flag = flagIsPresent<std::string>("--timings"); flag != "") script_timings = regexSplit(flag, std::regex(","));
     if (flagIsPresent<bool>("--no-progress") || flagIsPresent<bool>("-np")) progress_silent = true;
     if (flagIsPresent<bool>("--no-confirmation") || flagIsPresent<bool>("-nc")) confirmation_silent = true;
+    if (flagIsPresent<bool>("--archive") || flagIsPresent<bool>("-ar")) archive_mode = true;
+    if (flagIsPresent<bool>("--follow") || flagIsPresent<bool>("-f")) follow_output = true;
+    if (flagIsPresent<bool>("--tee") || flagIsPresent<bool>("-t")) {
+        tee_output = true;
+#if defined(UNIX_OR_UNIX_LIKE)
+        signal(SIGPIPE, SIG_IGN); // a reader that quits early shouldn't stop the content from getting stored
+#endif
+    }
     if (flagIsPresent<bool>("--secret") || flagIsPresent<bool>("-s")) secret_selection = true;
     if (flagIsPresent<bool>("--bachata")) {
         printf("%s", formatColors("[info]Here's some nice bachata music from Aventura! [help]https://www.youtube.com/watch?v=RxIM2bMBhCo\n[blank]").data());
@@ -539,11 +538,20 @@ void setFilepaths() {
     path = Clipboard(clipboard_name, clipboard_entry);
 }
 
+void demoteInBackground(const std::string& clipboard) {
+    // this is the helper demoteColdEntries starts, which does nothing else and waits for the lock like any other writer
+    clipboard_name = clipboard;
+    setFilepaths();
+    path.getLock();
+    path.demoteColdEntries();
+    exit(EXIT_SUCCESS);
+}
+
 void fixMissingItems() {
     using enum Action;
     if (action_is_one_of(Cut, Copy, Add) && io_type == IOType::File) {
         for (auto& item : copying.items) {
-            if (fs::exists(item)) continue;
+            if (cachedStatus(item).exists) continue;
             std::vector<std::string> candidates;
             for (const auto& entry : fs::directory_iterator(item.parent_path().empty() ? fs::current_path() : item.parent_path()))
                 candidates.emplace_back(entry.path().filename().string());
@@ -577,28 +585,25 @@ void checkForNoItems() {
     if (action_is_one_of(Cut, Copy, Add, Remove) && io_type != IOType::Pipe && copying.items.size() < 1) {
         error_exit(choose_action_items_message(), actions[action], actions[action], clipboard_invocation, actions[action]);
     }
-    if (((action_is_one_of(Paste, Show) || (action == Clear && !all_option && copying.items.size() == 0))) && (!fs::exists(path.data) || fs::is_empty(path.data))) {
+    if (((action_is_one_of(Paste, Show) || (action == Clear && !all_option && copying.items.size() == 0)))
+        && !path.segmentedEntry(path.entry()) && (!cachedStatus(path.data).exists || fs::is_empty(path.data))) {
         PerformAction::status();
         exit(EXIT_SUCCESS);
     }
 }
 
+void planCopy() {
+    using enum Action;
+    if (action_is_one_of(Cut, Copy, Add) && io_type == IOType::File) copying.plan.build(copying.items);
+}
+
 unsigned long long totalItemSize() {
     unsigned long long total_item_size = 0;
     using enum Action;
-    if (action_is_one_of(Cut, Copy, Add) && io_type == IOType::File) {
-        for (const auto& item : copying.items) {
-            try {
-                if (fs::is_directory(item))
-                    total_item_size += totalDirectorySize(item);
-                else
-                    total_item_size += fs::is_directory(item) ? directoryOverhead(item) : fs::file_size(item);
-            } catch (const fs::filesystem_error& e) {
-                copying.failedItems.emplace_back(item.string(), e.code());
-            }
-        }
-    } else if (action == Action::Paste && io_type == IOType::File)
-        total_item_size += totalDirectorySize(path.data);
+    if (action_is_one_of(Cut, Copy, Add) && io_type == IOType::File)
+        total_item_size = copying.plan.space;
+    else if (action == Action::Paste && io_type == IOType::File && !(cachedStatus(path.metadata.moved).exists && onSameFilesystem(path.data, fs::current_path())))
+        total_item_size += totalDirectorySize(path.data, true); // moved items are only renamed back out
     return total_item_size;
 }
 
@@ -618,14 +623,23 @@ void checkItemSize(unsigned long long total_item_size) {
 }
 
 void removeOldFiles(const std::vector<std::string>& exclusions) {
+    // moved items went back out with the paste itself, so there's nothing left of them to remove
+    if (copying.failedItems.empty()) {
+        auto moved = movedItemsIn(path.metadata.moved);
+        if (std::erase_if(moved, [&](const auto& item) {
+                return item.first == path.entryIndex.at(path.entry()) && std::find(exclusions.begin(), exclusions.end(), item.second.filename().string()) == exclusions.end();
+            }))
+            saveMovedItems(path.metadata.moved, moved);
+    }
     if (!fs::is_regular_file(path.metadata.originals)) return;
+    path.getLock(); // pasting is otherwise a read, so it only needs the lock once it starts removing cut items
     std::ifstream files(path.metadata.originals);
     std::string line;
     while (std::getline(files, line)) {
         if (auto res = std::find(exclusions.begin(), exclusions.end(), fs::path(line).filename().string()); res != exclusions.end()) continue;
         try {
-            fs::remove_all(line);
-            fs::remove_all(path.data / fs::path(line).filename());
+            removeRecursively(line);
+            removeRecursively(path.data / fs::path(line).filename());
         } catch (const fs::filesystem_error& e) {
             copying.failedItems.emplace_back(line, e.code());
         }
@@ -672,12 +686,20 @@ void performAction() {
             statusJSON();
         else if (action == Load)
             load();
+        else if (action == Import)
+            importClipboards();
+        else if (action == Export)
+            exportClipboards();
         else if (action == History)
             historyJSON();
         else if (action == Search)
             searchJSON();
         else if (action == Script)
             script();
+        else if (action == Undo)
+            undo();
+        else if (action == Redo)
+            redo();
         else
             complainAboutMissingAction("pipe");
     } else if (io_type == Text) {
@@ -719,6 +741,10 @@ void performAction() {
             config();
         else if (action == Script)
             script();
+        else if (action == Undo)
+            undo();
+        else if (action == Redo)
+            redo();
         else
             complainAboutMissingAction("text");
     }
@@ -0,0 +1,65 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Stream files as an archive"
+
+make_files
+
+ln -s testfile testdir/link
+
+cb copy testfile testdir
+
+cb paste --archive > items.tar
+
+setup_dir unpacked
+
+tar -xf ../items.tar
+
+item_exists testfile
+
+item_exists testdir/testfile
+
+assert_equals "testfile" "$(readlink testdir/link)"
+
+cd ..
+
+# an archive from tar unpacks into a new entry with the same structure
+tar -cf - testfile testdir | cb copy3 --archive
+
+item_is_in_cb 3 testfile
+
+item_is_in_cb 3 testdir/testfile
+
+setup_dir pasted
+
+export CLIPBOARD_FORCETTY=1
+
+cb paste3
+
+item_exists testdir/testfile
+
+unset CLIPBOARD_FORCETTY
+
+cd ..
+
+assert_fails sh -c 'echo "not an archive" | cb copy4 --archive'
+
+# a symlink that replaces a directory from earlier in the archive doesn't get that directory's mode
+mkdir outside evil
+
+chmod 700 outside
+
+mkdir evil/foo
+
+chmod 777 evil/foo
+
+tar -cf evil.tar -C evil foo
+
+rmdir evil/foo
+
+ln -s "$(pwd)/outside" evil/foo
+
+tar -rf evil.tar -C evil foo
+
+cb copy5 --archive < evil.tar
+
+assert_equals "700" "$(stat -c %a outside)"
@@ -0,0 +1,42 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Compress stored data"
+
+export CLIPBOARD_COMPRESS=zlib
+
+i=0
+while [ "$i" -lt 1000 ]
+do
+    echo "Foobar log line $i"
+    i=$((i + 1))
+done > biglog
+
+cb copy9 < biglog
+
+cb paste9 > temp
+
+items_match temp biglog
+
+echo "Foobar" | cb add9
+
+cat biglog > expected
+echo "Foobar" >> expected
+
+cb paste9 > temp
+
+items_match temp expected
+
+# the uncompressed size is known without decompressing, and the file is still one that gzip reads
+assert_equals "$(wc -c < expected | tr -dc '0-9')" "$(cb info9 | grep contentBytes | tr -dc '0-9')"
+
+gzip -dc < "$CLIPBOARD_TMPDIR"/Clipboard/9/data/"$(get_current_entry_name 9)"/rawdata.clipboard.gz > temp
+
+items_match temp expected
+
+cb copy9 < ../TurnYourClipboardUp.png
+
+[ -f "$CLIPBOARD_TMPDIR"/Clipboard/9/data/"$(get_current_entry_name 9)"/rawdata.clipboard ] || fail "😕 Already compressed data was compressed again"
+
+cb paste9 > temp
+
+items_match temp ../TurnYourClipboardUp.png
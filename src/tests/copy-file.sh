@@ -73,4 +73,42 @@ cb --fast-copy paste
 
 items_match TurnYourClipboardUp.png ../TurnYourClipboardUp.png
 
-assert_fails cb copy testfile foo bar baz
\ No newline at end of file
+assert_fails cb copy testfile foo bar baz
+
+mkdir linkdir
+
+echo "Foobar" > linkdir/original
+
+ln linkdir/original linkdir/link
+
+cb copy linkdir
+
+item_is_in_cb 0 linkdir/link
+
+# hard links to each other stay that way in the clipboard
+entry="$(get_current_entry_name 0)"
+assert_equals "2" "$(ls -l "$CLIPBOARD_TMPDIR"/Clipboard/0/data/"$entry"/linkdir/link | awk '{print $2}')"
+
+rm -f TurnYourClipboardUp.png
+
+CLIPBOARD_RANGED_COPY_THRESHOLD=1kb CLIPBOARD_COPY_THREADS=4 cb copy ../TurnYourClipboardUp.png
+
+cb paste
+
+items_match TurnYourClipboardUp.png ../TurnYourClipboardUp.png
+
+rm -f TurnYourClipboardUp.png
+
+# a file that's almost all hole
+dd if=/dev/zero of=sparse bs=1 count=1 seek=67108864 2>/dev/null
+
+cb copy sparse
+
+entry="$(get_current_entry_name 0)"
+items_match sparse "$CLIPBOARD_TMPDIR"/Clipboard/0/data/"$entry"/sparse
+
+# holes only stay holes where the filesystem made one to begin with
+if [ "$(du -k sparse | cut -f1)" -lt 1024 ]
+then
+    assert_equals "1" "$([ "$(du -k "$CLIPBOARD_TMPDIR"/Clipboard/0/data/"$entry"/sparse | cut -f1)" -lt 1024 ] && echo 1)"
+fi
@@ -18,4 +18,13 @@ cb < ../TurnYourClipboardUp.png
 
 cb paste > temp # work around github actions tty bug
 
-items_match temp ../TurnYourClipboardUp.png
\ No newline at end of file
+items_match temp ../TurnYourClipboardUp.png
+
+# piping through the clipboard passes the content along while storing it
+cat ../TurnYourClipboardUp.png | cb --tee | cat > teed
+
+items_match teed ../TurnYourClipboardUp.png
+
+cb paste > temp
+
+items_match temp ../TurnYourClipboardUp.png
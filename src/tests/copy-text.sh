@@ -5,4 +5,12 @@ start_test "Copy user provided text"
 
 cb copy "Foobar"
 
-item_is_in_cb 0 rawdata.clipboard
\ No newline at end of file
+item_is_in_cb 0 rawdata.clipboard
+# a writer that was killed partway leaves its staging directory behind, and the next one to take the lock removes it
+mkdir -p "$CLIPBOARD_TMPDIR"/Clipboard/0/data/.999999.staging
+
+cb copy "Foobar"
+
+[ ! -d "$CLIPBOARD_TMPDIR"/Clipboard/0/data/.999999.staging ] || fail "😕 A stale staging directory wasn't removed"
+
+item_is_in_cb 0 rawdata.clipboard
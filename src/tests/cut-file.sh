@@ -15,4 +15,101 @@ cd ../
 
 item_is_not_here testfile
 
-item_is_not_here testdir/testfile
\ No newline at end of file
+item_is_not_here testdir/testfile
+
+mkdir movedir
+
+echo "Foobar" > movedir/testfile
+
+# persistent clipboards get cut items moved in when they share a filesystem, and undoing that puts them back
+cb cut_moved movedir
+
+cb undo_moved
+
+item_exists movedir/testfile
+
+cb redo_moved
+
+setup_dir movedhere
+
+cb paste_moved
+
+item_exists movedir/testfile
+
+cd ../
+
+item_is_not_here movedir/testfile
+
+# until it's pasted, the entry a cut moved an item into holds the only copy of it, so trimming the history leaves that entry alone
+mkdir pinned
+
+echo "Foobar" > pinned/testfile
+
+cb cut_pinned pinned/testfile
+
+cb clear_pinned
+
+CLIPBOARD_HISTORY=2 cb copy_pinned "Text 1"
+
+CLIPBOARD_HISTORY=2 cb copy_pinned "Text 2"
+
+CLIPBOARD_HISTORY=2 cb copy_pinned "Text 3"
+
+# and a later copy of something with the same name stays in its own entry
+echo "Barfoo" > pinned/testfile
+
+cb copy_pinned pinned/testfile
+
+setup_dir pinnedhere
+
+cb paste_pinned
+
+item_exists testfile "Barfoo"
+
+cd ../
+
+setup_dir pinnedagain
+
+cb paste_pinned
+
+item_exists testfile "Barfoo"
+
+cd ../
+
+oldest="$(unset CLIPBOARD_FORCETTY; cb history_pinned 2>/dev/null | grep -o '"[0-9]*": {' | tail -n 1 | tr -dc '0-9')"
+
+setup_dir pinnedlast
+
+cb paste_pinned -e "$oldest"
+
+item_exists testfile "Foobar"
+
+cd ../
+
+# clearing an entry a cut moved something into puts that back where it was cut from first
+mkdir cleared
+
+echo "Foobar" > cleared/testfile
+
+cb cut_cleared cleared/testfile
+
+cb copy_cleared "Other text"
+
+cb clear_cleared 1
+
+item_exists cleared/testfile
+
+# unless something else is there now, and then nothing is cleared
+cb cut_cleared cleared/testfile
+
+echo "Barfoo" > cleared/testfile
+
+assert_fails cb clear_cleared 0
+
+item_exists cleared/testfile "Barfoo"
+
+rm cleared/testfile
+
+cb clear_cleared 0
+
+item_exists cleared/testfile "Foobar"
@@ -0,0 +1,34 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Evict the least used entries before copying"
+
+export CLIPBOARD_HISTORY=350kb
+export CLIPBOARD_EVICTION=lfu
+
+for name in A B C D
+do
+    head -c 100000 /dev/zero | tr '\0' "$name" > "$name"
+done
+
+cb copy4 A
+
+cb copy4 B
+
+cb copy4 C
+
+cb paste4 -e 2 > /dev/null
+
+cb paste4 -e 2 > /dev/null
+
+cb copy4 D
+
+history="$(cb history4 2>&1)"
+
+content_is_shown "$history" "/A"
+
+content_is_shown "$history" "/D"
+
+if printf "%s" "$history" | grep -q "/B"
+then
+    fail "😕 The least used entry wasn't evicted"
+fi
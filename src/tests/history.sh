@@ -44,4 +44,37 @@ content_is_shown "$json" '"content": "Some text 3"'
 
 content_is_shown "$json" '"content": "Some text 4"'
 
-content_is_shown "$json" '"content": "Some text 5"'
\ No newline at end of file
+content_is_shown "$json" '"content": "Some text 5"'
+# reading an older entry takes it straight from its segment without moving it back out
+entries="$(ls "$CLIPBOARD_TMPDIR"/Clipboard/0/data | wc -l)"
+
+older="$(cb paste -e 3 < /dev/null)"
+
+[ "$older" = "Some text 2" ] || fail "😕 An older entry doesn't have the right content: $older"
+
+[ "$(ls "$CLIPBOARD_TMPDIR"/Clipboard/0/data | wc -l)" -eq "$entries" ] || fail "😕 Reading an older entry moved it out of its segment"
+
+# entries in an older shard are only listed once history and search reach them
+export CLIPBOARD_SHARDED=1
+
+cb copy8 "Before the boundary"
+
+mkdir -p "$CLIPBOARD_TMPDIR"/Clipboard/8/data/1.shard/4100
+
+printf "%s" "Past the boundary" > "$CLIPBOARD_TMPDIR"/Clipboard/8/data/1.shard/4100/rawdata.clipboard
+
+cb copy8 "Newest"
+
+json="$(cb history8 2>&1)"
+
+content_is_shown "$json" '"content": "Past the boundary"'
+
+content_is_shown "$json" '"content": "Before the boundary"'
+
+export CLIPBOARD_FORCETTY=1
+
+content_is_shown "$(cb history8 2>&1)" "Before the boundary"
+
+content_is_shown "$(cb search8 "Before the boundary" 2>&1)" "Before the boundary"
+
+unset CLIPBOARD_SHARDED
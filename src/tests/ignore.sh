@@ -24,4 +24,46 @@ cb ignore "testdir"
 
 item_is_not_in_cb 0 "testdir"
 
-cb ignore ""
\ No newline at end of file
+cb ignore ""
+cb ignore "[0-9]" "baz"
+
+cb copy "Foo1barbaz"
+
+item_is_in_cb 0 rawdata.clipboard
+
+cb ignore ""
+
+# a backreference only ever refers to a group in its own pattern
+cb ignore "(z)z" "(o)\1"
+
+cb copy "Fobar"
+
+item_exists "$CLIPBOARD_TMPDIR"/Clipboard/0/data/"$(get_current_entry_name 0)"/rawdata.clipboard "Fobar"
+
+cb ignore ""
+
+# patterns from before the manifest still apply, and move into it for good the first time the clipboard is used
+mkdir -p "$CLIPBOARD_TMPDIR"/Clipboard/8/metadata
+
+echo "testfile" > "$CLIPBOARD_TMPDIR"/Clipboard/8/metadata/ignore
+
+cb copy8 testfile testdir
+
+item_is_not_in_cb 8 "testfile"
+
+item_is_in_cb 8 "testdir"
+
+[ ! -f "$CLIPBOARD_TMPDIR"/Clipboard/8/metadata/ignore ] || fail "😕 The old ignore file is still there"
+
+# and so do they when the first use only reads the clipboard
+mkdir -p "$CLIPBOARD_TMPDIR"/Clipboard/6/metadata
+
+echo "testfile" > "$CLIPBOARD_TMPDIR"/Clipboard/6/metadata/ignore
+
+cb info6 > /dev/null 2>&1
+
+[ ! -f "$CLIPBOARD_TMPDIR"/Clipboard/6/metadata/ignore ] || fail "😕 The old ignore file is still there"
+
+cb copy6 testfile testdir
+
+item_is_not_in_cb 6 "testfile"
@@ -0,0 +1,25 @@
+#!/bin/sh
+. ./resources.sh
+export CLIPBOARD_FORCETTY=1
+start_test "Load clipboards into others"
+
+make_files
+
+cb copy testfile testdir
+
+cb load 1
+
+item_is_in_cb 1 testfile
+
+item_is_in_cb 1 testdir/testfile
+
+# a fast load leaves hard links behind, and loading over them again mustn't empty the source
+cb load --fast-copy 2
+
+cb load 2
+
+item_is_in_cb 0 testfile
+
+item_is_in_cb 2 testfile
+
+item_is_in_cb 2 testdir/testfile
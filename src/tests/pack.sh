@@ -0,0 +1,35 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Export and import packs"
+
+export CLIPBOARD_FORCETTY=1
+
+cb copy5 "Some text"
+
+make_files
+
+cb copy6 testfile testdir
+
+cb export --pack clipboards.cbpack 5 6
+
+rm -rf "$CLIPBOARD_TMPDIR"/Clipboard/5 "$CLIPBOARD_TMPDIR"/Clipboard/6
+
+cb import clipboards.cbpack
+
+item_exists "$CLIPBOARD_TMPDIR"/Clipboard/5/data/"$(get_current_entry_name 5)"/rawdata.clipboard "Some text"
+
+item_is_in_cb 6 testfile
+
+item_is_in_cb 6 testdir/testfile
+
+unset CLIPBOARD_FORCETTY
+
+cb export --pack - 6 > piped.cbpack
+
+rm -rf "$CLIPBOARD_TMPDIR"/Clipboard/6
+
+cb import < piped.cbpack
+
+item_is_in_cb 6 testfile
+
+item_is_in_cb 6 testdir/testfile
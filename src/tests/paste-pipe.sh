@@ -8,4 +8,43 @@ export CLIPBOARD_FORCETTY=1
 
 cb paste
 
-item_exists clipboard0-0.txt
\ No newline at end of file
+item_exists clipboard0-0.txt
+
+unset CLIPBOARD_FORCETTY
+
+cb copy < ../TurnYourClipboardUp.png
+
+# the image is over this threshold, so it skips the page cache without that changing what comes out
+CLIPBOARD_STREAMING_THRESHOLD=1kb cb paste > streamed.png
+
+items_match streamed.png ../TurnYourClipboardUp.png
+
+# the entry goes up while it's still being written, and following it keeps going until the writer is done
+(echo "Foo"; sleep 1; echo "bar") | cb &
+
+sleep 0.5
+
+cb paste --follow > followed.txt
+
+wait
+
+assert_equals "Foo
+bar" "$(cat followed.txt)"
+
+# with ignore rules set, nothing goes up until they've been applied to all of it
+cb ignore9 "password[0-9]+"
+
+(echo "Foo password123"; sleep 1; echo "bar") | cb copy9 &
+
+sleep 0.5
+
+cb paste9 > early.txt 2>/dev/null || true
+
+wait
+
+grep -q "password123" early.txt && fail "😕 Ignored content showed up while it was still being piped in"
+
+assert_equals "Foo 
+bar" "$(cb paste9)"
+
+cb ignore9 ""
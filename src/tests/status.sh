@@ -29,4 +29,41 @@ content_is_shown "$content" "testfile"
 
 content_is_shown "$content" "testdir"
 
-content_is_shown "$content" "0"
\ No newline at end of file
+content_is_shown "$content" "0"
+# the first status builds the catalog, after which writes keep it current
+[ -f "$CLIPBOARD_TMPDIR"/Clipboard/.catalog ] || fail "😕 Status didn't build a catalog"
+
+cb copy2 "Catalogued text"
+
+content="$(cb status 2>&1)"
+
+content_is_shown "$content" "Catalogued text"
+
+cb clear2
+
+content="$(cb status 2>&1)"
+
+content_is_shown "$content" "testfile"
+
+if echo "$content" | grep -q "Catalogued text"
+then
+    fail "😕 A cleared clipboard still showed up"
+fi
+
+# searching everything rules clipboards out by what the catalog knows is in them, so older entries still have to be counted
+cb copy3 "Zebra crossing"
+
+cb copy3 "Something newer"
+
+content_is_shown "$(cb search --all "Zebra crossing" 2>&1)" "Zebra crossing"
+
+assert_fails cb search --all "~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~"
+
+# and a rebuilt catalog only opens what's really a clipboard
+mkdir -p "$CLIPBOARD_TMPDIR"/Clipboard/stray
+
+rm "$CLIPBOARD_TMPDIR"/Clipboard/.catalog
+
+content_is_shown "$(cb search --all "Zebra crossing" 2>&1)" "Zebra crossing"
+
+[ ! -d "$CLIPBOARD_TMPDIR"/Clipboard/stray/metadata ] || fail "😕 Rebuilding the catalog turned a stray directory into a clipboard"
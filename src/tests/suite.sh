@@ -24,6 +24,13 @@ export CLIPBOARD_NOAUDIO=1
 
 run_all_tests() {
     sh export.sh
+    sh pack.sh
+    sh compress.sh
+    sh tiers.sh
+    sh evict.sh
+    sh undo.sh
+    sh load.sh
+    sh archive.sh
     sh history.sh
     sh ignore.sh
     sh add-file.sh
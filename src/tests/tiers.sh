@@ -0,0 +1,27 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Move older entries out of RAM"
+
+export CLIPBOARD_PERSISTDIR="$PWD/persistent"
+export CLIPBOARD_HOT_TIER=2
+
+i=1
+while [ "$i" -le 5 ]
+do
+    echo "Foobar $i" | cb copy7
+    i=$((i + 1))
+done
+
+# the older entries move over in the background, which takes the lock once the copies are done and holds it until it's done too
+i=0
+while { [ ! -d "$CLIPBOARD_PERSISTDIR"/7 ] || [ -f "$CLIPBOARD_TMPDIR"/Clipboard/7/metadata/lock ]; } && [ "$i" -lt 50 ]
+do
+    sleep 0.1
+    i=$((i + 1))
+done
+
+[ -d "$CLIPBOARD_PERSISTDIR"/7 ] || fail "😕 The older entries stayed in RAM"
+
+assert_equals "Foobar 5" "$(cb paste7)"
+
+assert_equals "Foobar 1" "$(cb paste7 -e 4)"
@@ -0,0 +1,51 @@
+#!/bin/sh
+. ./resources.sh
+start_test "Undo and redo changes to a clipboard"
+
+cb copy9 "Undone text"
+
+cb copy9 "Redone text"
+
+cb undo9
+
+assert_equals "Undone text" "$(cb paste9)"
+
+cb redo9
+
+assert_equals "Redone text" "$(cb paste9)"
+
+cb add9 " and more"
+
+cb undo9
+
+assert_equals "Redone text" "$(cb paste9)"
+
+cb redo9
+
+assert_equals "Redone text and more" "$(cb paste9)"
+
+assert_fails cb redo9
+
+cb copy7 "Seventh text"
+
+cb copy8 "Eighth text"
+
+cb swap7 8
+
+cb undo7
+
+assert_equals "Seventh text" "$(cb paste7)"
+
+assert_equals "Eighth text" "$(cb paste8)"
+
+cb redo8
+
+assert_equals "Eighth text" "$(cb paste7)"
+
+assert_equals "Seventh text" "$(cb paste8)"
+
+cb load9 7
+
+cb undo7
+
+assert_equals "Eighth text" "$(cb paste7)"